@@ -0,0 +1,241 @@
+//
+//  Scene.cpp
+//  Vortex2D
+//
+
+#include "Scene.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+class LineReader
+{
+public:
+  LineReader(const std::string& line, int lineNumber) : mStream(line), mLineNumber(lineNumber) {}
+
+  std::string Word()
+  {
+    std::string word;
+    if (!(mStream >> word))
+    {
+      Error("missing value");
+    }
+    return word;
+  }
+
+  float Float()
+  {
+    float value;
+    if (!(mStream >> value))
+    {
+      Error("expected number");
+    }
+    return value;
+  }
+
+  int Int()
+  {
+    int value;
+    if (!(mStream >> value))
+    {
+      Error("expected integer");
+    }
+    return value;
+  }
+
+  glm::vec2 Vec2()
+  {
+    float x = Float();
+    float y = Float();
+    return {x, y};
+  }
+
+  bool Optional(float& value)
+  {
+    return static_cast<bool>(mStream >> value);
+  }
+
+  bool HasMore()
+  {
+    mStream >> std::ws;
+    return !mStream.eof();
+  }
+
+  void Error(const std::string& message)
+  {
+    throw std::runtime_error("Scene line " + std::to_string(mLineNumber) + ": " + message);
+  }
+
+private:
+  std::istringstream mStream;
+  int mLineNumber;
+};
+
+SceneShape ReadShape(LineReader& reader)
+{
+  SceneShape shape;
+
+  auto type = reader.Word();
+  if (type == "rectangle" || type == "boundary")
+  {
+    shape.ShapeType =
+        type == "rectangle" ? SceneShape::Type::Rectangle : SceneShape::Type::Boundary;
+    shape.Position = reader.Vec2();
+    shape.Size = reader.Vec2();
+    shape.Rotation = reader.Float();
+  }
+  else if (type == "circle")
+  {
+    shape.ShapeType = SceneShape::Type::Circle;
+    shape.Position = reader.Vec2();
+    shape.Radius = reader.Float();
+  }
+  else if (type == "polygon")
+  {
+    shape.ShapeType = SceneShape::Type::Polygon;
+    shape.Position = reader.Vec2();
+    while (reader.HasMore())
+    {
+      shape.Points.push_back(reader.Vec2());
+    }
+
+    if (shape.Points.size() < 3)
+    {
+      reader.Error("polygon needs at least 3 points");
+    }
+  }
+  else
+  {
+    reader.Error("unknown shape " + type);
+  }
+
+  return shape;
+}
+}  // namespace
+
+Scene LoadScene(const std::string& filename)
+{
+  std::ifstream file(filename);
+  if (!file)
+  {
+    throw std::runtime_error("Cannot open scene " + filename);
+  }
+
+  Scene scene;
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(file, line))
+  {
+    lineNumber++;
+
+    LineReader reader(line, lineNumber);
+    if (!reader.HasMore() || line[line.find_first_not_of(" \t")] == '#')
+    {
+      continue;
+    }
+
+    auto keyword = reader.Word();
+    if (keyword == "world")
+    {
+      auto type = reader.Word();
+      if (type == "smoke")
+        scene.World = Scene::WorldType::Smoke;
+      else if (type == "water")
+        scene.World = Scene::WorldType::Water;
+      else
+        reader.Error("unknown world " + type);
+    }
+    else if (keyword == "size")
+    {
+      scene.Size.x = reader.Int();
+      scene.Size.y = reader.Int();
+    }
+    else if (keyword == "dt")
+    {
+      scene.Delta = reader.Float();
+    }
+    else if (keyword == "substeps")
+    {
+      scene.NumSubSteps = reader.Int();
+    }
+    else if (keyword == "steps")
+    {
+      scene.Steps = reader.Int();
+    }
+    else if (keyword == "output")
+    {
+      scene.OutputInterval = reader.Int();
+    }
+    else if (keyword == "interpolation")
+    {
+      auto mode = reader.Word();
+      if (mode == "linear")
+        scene.Interpolation = Vortex2D::Fluid::Velocity::InterpolationMode::Linear;
+      else if (mode == "cubic")
+        scene.Interpolation = Vortex2D::Fluid::Velocity::InterpolationMode::Cubic;
+      else
+        reader.Error("unknown interpolation " + mode);
+    }
+    else if (keyword == "solver")
+    {
+      auto type = reader.Word();
+      if (type == "fixed")
+        scene.SolverParams = Vortex2D::Fluid::FixedParams(reader.Int());
+      else if (type == "iterative")
+        scene.SolverParams = Vortex2D::Fluid::IterativeParams(reader.Float());
+      else
+        reader.Error("unknown solver " + type);
+    }
+    else if (keyword == "gravity")
+    {
+      scene.Gravity = reader.Vec2();
+    }
+    else if (keyword == "fluid")
+    {
+      scene.Fluids.push_back(ReadShape(reader));
+    }
+    else if (keyword == "obstacle")
+    {
+      scene.Obstacles.push_back(ReadShape(reader));
+    }
+    else if (keyword == "emitter")
+    {
+      SceneEmitter emitter;
+      emitter.Position = reader.Vec2();
+      emitter.Size = reader.Vec2();
+      emitter.Velocity = reader.Vec2();
+      for (int i = 0; i < 4 && reader.HasMore(); i++)
+      {
+        emitter.Colour[i] = reader.Float();
+      }
+      scene.Emitters.push_back(emitter);
+    }
+    else if (keyword == "rigidbody")
+    {
+      SceneRigidBody rigidbody;
+      rigidbody.Shape = ReadShape(reader);
+      if (rigidbody.Shape.ShapeType == SceneShape::Type::Polygon)
+      {
+        reader.Error("polygon rigidbodies are not supported");
+      }
+      rigidbody.Velocity = reader.Vec2();
+      reader.Optional(rigidbody.AngularVelocity);
+      scene.RigidBodies.push_back(rigidbody);
+    }
+    else
+    {
+      reader.Error("unknown keyword " + keyword);
+    }
+  }
+
+  if (scene.Size.x <= 0 || scene.Size.y <= 0 || scene.Delta <= 0.0f || scene.NumSubSteps <= 0 ||
+      scene.OutputInterval <= 0)
+  {
+    throw std::runtime_error("Invalid scene parameters in " + filename);
+  }
+
+  return scene;
+}
@@ -0,0 +1,93 @@
+//
+//  Scene.h
+//  Vortex2D
+//
+
+#ifndef Batch_Scene_h
+#define Batch_Scene_h
+
+#include <Vortex2D/Vortex2D.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Shape of an obstacle, emitter, fluid area or rigidbody.
+ */
+struct SceneShape
+{
+  enum class Type
+  {
+    Rectangle,
+    Boundary,
+    Circle,
+    Polygon,
+  };
+
+  Type ShapeType = Type::Rectangle;
+  glm::vec2 Position = glm::vec2(0.0f);
+  float Rotation = 0.0f;
+  glm::vec2 Size = glm::vec2(0.0f);
+  float Radius = 0.0f;
+  std::vector<glm::vec2> Points;
+};
+
+/**
+ * @brief Area where velocity is set each step, and density (smoke) or
+ * particles (water) are added.
+ */
+struct SceneEmitter
+{
+  glm::vec2 Position = glm::vec2(0.0f);
+  glm::vec2 Size = glm::vec2(0.0f);
+  glm::vec2 Velocity = glm::vec2(0.0f);
+  glm::vec4 Colour = glm::vec4(1.0f);
+};
+
+/**
+ * @brief Rigidbody moving at a constant velocity through the fluid.
+ */
+struct SceneRigidBody
+{
+  SceneShape Shape;
+  glm::vec2 Velocity = glm::vec2(0.0f);
+  float AngularVelocity = 0.0f;
+};
+
+/**
+ * @brief Description of a headless simulation.
+ */
+struct Scene
+{
+  enum class WorldType
+  {
+    Smoke,
+    Water,
+  };
+
+  WorldType World = WorldType::Smoke;
+  glm::ivec2 Size = glm::ivec2(256);
+  float Delta = 0.016f;
+  int NumSubSteps = 1;
+  int Steps = 100;
+  int OutputInterval = 1;
+  Vortex2D::Fluid::Velocity::InterpolationMode Interpolation =
+      Vortex2D::Fluid::Velocity::InterpolationMode::Linear;
+  Vortex2D::Fluid::LinearSolver::Parameters SolverParams = Vortex2D::Fluid::FixedParams(12);
+  glm::vec2 Gravity = glm::vec2(0.0f);
+
+  std::vector<SceneShape> Fluids;
+  std::vector<SceneShape> Obstacles;
+  std::vector<SceneEmitter> Emitters;
+  std::vector<SceneRigidBody> RigidBodies;
+};
+
+/**
+ * @brief Load a scene from a text file. Each line is a keyword followed by its
+ * values, lines starting with # are ignored. Throws on invalid lines.
+ * @param filename path to the scene file
+ * @return the scene
+ */
+Scene LoadScene(const std::string& filename);
+
+#endif
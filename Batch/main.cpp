@@ -0,0 +1,362 @@
+#include <Vortex2D/Engine/Boundaries.h>
+#include <Vortex2D/Engine/Rigidbody.h>
+#include <Vortex2D/Vortex2D.h>
+
+#include "Scene.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <glm/gtc/type_precision.hpp>
+#include <glm/trigonometric.hpp>
+
+using namespace Vortex2D;
+
+/**
+ * @brief Rigidbody moving at a constant linear and angular velocity.
+ */
+class KinematicRigidBody : public Fluid::RigidBody
+{
+public:
+  KinematicRigidBody(const Renderer::Device& device,
+                     const glm::ivec2& size,
+                     Renderer::Drawable& drawable,
+                     float delta,
+                     const glm::vec2& velocity,
+                     float angularVelocity)
+      : Fluid::RigidBody(device, size, drawable, Fluid::RigidBody::Type::eStatic)
+      , mDelta(delta)
+      , mVelocity(velocity)
+      , mAngularVelocity(angularVelocity)
+  {
+    SetVelocities(mVelocity, mAngularVelocity);
+  }
+
+  void ApplyVelocities() override
+  {
+    Position += mVelocity * mDelta;
+    Rotation += glm::degrees(mAngularVelocity * mDelta);
+    SetVelocities(mVelocity, mAngularVelocity);
+  }
+
+private:
+  float mDelta;
+  glm::vec2 mVelocity;
+  float mAngularVelocity;
+};
+
+std::unique_ptr<Renderer::Drawable> MakeShape(const Renderer::Device& device,
+                                              const SceneShape& shape,
+                                              bool positioned = true)
+{
+  switch (shape.ShapeType)
+  {
+    case SceneShape::Type::Rectangle:
+    case SceneShape::Type::Boundary:
+    {
+      bool inverse = shape.ShapeType == SceneShape::Type::Boundary;
+      auto rectangle = std::make_unique<Fluid::Rectangle>(device, shape.Size, inverse);
+      if (positioned)
+      {
+        rectangle->Position = shape.Position;
+        rectangle->Rotation = shape.Rotation;
+      }
+      rectangle->Anchor = shape.Size / glm::vec2(2.0f);
+      return std::move(rectangle);
+    }
+    case SceneShape::Type::Circle:
+    {
+      auto circle = std::make_unique<Fluid::Circle>(device, shape.Radius);
+      if (positioned)
+      {
+        circle->Position = shape.Position;
+      }
+      return std::move(circle);
+    }
+    case SceneShape::Type::Polygon:
+    {
+      auto polygon = std::make_unique<Fluid::Polygon>(device, shape.Points);
+      if (positioned)
+      {
+        polygon->Position = shape.Position;
+      }
+      return std::move(polygon);
+    }
+  }
+
+  throw std::runtime_error("Unknown shape");
+}
+
+template <typename T>
+std::vector<T> ReadTexture(const Renderer::Device& device, Renderer::Texture& texture)
+{
+  Renderer::Texture localTexture(device,
+                                 texture.GetWidth(),
+                                 texture.GetHeight(),
+                                 texture.GetFormat(),
+                                 VMA_MEMORY_USAGE_CPU_ONLY);
+
+  device.Execute(
+      [&](vk::CommandBuffer commandBuffer) { localTexture.CopyFrom(commandBuffer, texture); });
+
+  std::vector<T> data(texture.GetWidth() * texture.GetHeight());
+  localTexture.CopyTo(data);
+  return data;
+}
+
+// Portable float map, rows are stored bottom to top.
+void WritePFM(const std::string& filename,
+              const glm::ivec2& size,
+              int channels,
+              const std::vector<float>& data)
+{
+  std::ofstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    throw std::runtime_error("Cannot write " + filename);
+  }
+
+  file << (channels == 3 ? "PF" : "Pf") << "\n" << size.x << " " << size.y << "\n-1.0\n";
+  for (int j = size.y - 1; j >= 0; j--)
+  {
+    file.write(reinterpret_cast<const char*>(data.data() + j * size.x * channels),
+               sizeof(float) * size.x * channels);
+  }
+}
+
+void WriteVelocity(const std::string& filename,
+                   const Renderer::Device& device,
+                   const glm::ivec2& size,
+                   Renderer::Texture& velocity)
+{
+  auto velocityData = ReadTexture<glm::vec2>(device, velocity);
+
+  std::vector<float> data;
+  data.reserve(3 * velocityData.size());
+  for (auto& v : velocityData)
+  {
+    data.push_back(v.x);
+    data.push_back(v.y);
+    data.push_back(0.0f);
+  }
+
+  WritePFM(filename, size, 3, data);
+}
+
+void WritePhi(const std::string& filename,
+              const Renderer::Device& device,
+              const glm::ivec2& size,
+              Renderer::Texture& phi)
+{
+  WritePFM(filename, size, 1, ReadTexture<float>(device, phi));
+}
+
+void WriteDensity(const std::string& filename,
+                  const Renderer::Device& device,
+                  const glm::ivec2& size,
+                  Renderer::Texture& density)
+{
+  auto densityData = ReadTexture<glm::u8vec4>(device, density);
+
+  std::ofstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    throw std::runtime_error("Cannot write " + filename);
+  }
+
+  file << "P6\n" << size.x << " " << size.y << "\n255\n";
+  for (auto& colour : densityData)
+  {
+    file.write(reinterpret_cast<const char*>(&colour), 3);
+  }
+}
+
+std::string FrameName(const std::string& output, const std::string& field, int frame)
+{
+  char number[16];
+  std::snprintf(number, sizeof(number), "%05d", frame);
+  return output + "/" + field + "_" + number;
+}
+
+void Run(const Renderer::Device& device, const Scene& scene, const std::string& output)
+{
+  std::unique_ptr<Fluid::World> world;
+  std::unique_ptr<Fluid::Density> density;
+
+  if (scene.World == Scene::WorldType::Smoke)
+  {
+    auto smokeWorld =
+        std::make_unique<Fluid::SmokeWorld>(device, scene.Size, scene.Delta, scene.Interpolation);
+
+    density = std::make_unique<Fluid::Density>(device, scene.Size, vk::Format::eR8G8B8A8Unorm);
+    smokeWorld->FieldBind(*density);
+
+    Renderer::Clear liquidClear({-1.0f, 0.0f, 0.0f, 0.0f});
+    smokeWorld->RecordLiquidPhi({liquidClear}).Submit().Wait();
+
+    world = std::move(smokeWorld);
+  }
+  else
+  {
+    auto waterWorld = std::make_unique<Fluid::WaterWorld>(
+        device, scene.Size, scene.Delta, scene.NumSubSteps, scene.Interpolation);
+
+    for (auto& fluid : scene.Fluids)
+    {
+      if (fluid.ShapeType != SceneShape::Type::Rectangle)
+      {
+        throw std::runtime_error("Water fluid areas must be rectangles");
+      }
+
+      Renderer::IntRectangle fluidArea(device, fluid.Size);
+      fluidArea.Position = fluid.Position - fluid.Size / glm::vec2(2.0f);
+      fluidArea.Colour = glm::vec4(4);
+
+      waterWorld->RecordParticleCount({fluidArea}).Submit().Wait();
+    }
+
+    world = std::move(waterWorld);
+  }
+
+  // Static obstacles, drawn one by one with a union blend
+  world->RecordStaticSolidPhi({Fluid::BoundariesClear}).Submit().Wait();
+  for (auto& obstacle : scene.Obstacles)
+  {
+    auto shape = MakeShape(device, obstacle);
+    world->RecordStaticSolidPhi({*shape}).Submit().Wait();
+  }
+
+  // Rigidbodies
+  std::vector<std::unique_ptr<Renderer::Drawable>> rigidbodyShapes;
+  std::vector<std::unique_ptr<KinematicRigidBody>> rigidbodies;
+  for (auto& rigidbody : scene.RigidBodies)
+  {
+    rigidbodyShapes.push_back(MakeShape(device, rigidbody.Shape, false));
+    rigidbodies.push_back(
+        std::make_unique<KinematicRigidBody>(device,
+                                             scene.Size,
+                                             *rigidbodyShapes.back(),
+                                             scene.Delta / scene.NumSubSteps,
+                                             rigidbody.Velocity,
+                                             rigidbody.AngularVelocity));
+    rigidbodies.back()->Position = rigidbody.Shape.Position;
+    rigidbodies.back()->Rotation = rigidbody.Shape.Rotation;
+    world->AddRigidbody(*rigidbodies.back());
+  }
+
+  // Gravity and emitters
+  Renderer::Rectangle gravity(device, scene.Size);
+  gravity.Colour = glm::vec4(scene.Delta * scene.Gravity, 0.0f, 0.0f);
+  auto gravityRender = world->RecordVelocity({gravity}, Fluid::VelocityOp::Add);
+
+  std::vector<std::unique_ptr<Renderer::Rectangle>> forces, sources;
+  std::vector<std::unique_ptr<Renderer::IntRectangle>> particleSources;
+  std::vector<Renderer::RenderCommand> forceRenders, sourceRenders;
+  for (auto& emitter : scene.Emitters)
+  {
+    auto position = emitter.Position - emitter.Size / glm::vec2(2.0f);
+
+    forces.push_back(std::make_unique<Renderer::Rectangle>(device, emitter.Size));
+    forces.back()->Position = position;
+    forces.back()->Colour = glm::vec4(emitter.Velocity, 0.0f, 0.0f);
+    forceRenders.push_back(world->RecordVelocity({*forces.back()}, Fluid::VelocityOp::Set));
+
+    if (scene.World == Scene::WorldType::Smoke)
+    {
+      sources.push_back(std::make_unique<Renderer::Rectangle>(device, emitter.Size));
+      sources.back()->Position = position;
+      sources.back()->Colour = emitter.Colour;
+      sourceRenders.push_back(density->Record({*sources.back()}));
+    }
+    else
+    {
+      particleSources.push_back(std::make_unique<Renderer::IntRectangle>(device, emitter.Size));
+      particleSources.back()->Position = position;
+      particleSources.back()->Colour = glm::vec4(4);
+      sourceRenders.push_back(static_cast<Fluid::WaterWorld&>(*world).RecordParticleCount(
+          {*particleSources.back()}));
+    }
+  }
+
+  auto params = scene.SolverParams;
+  for (int i = 0; i < scene.Steps; i++)
+  {
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto& sourceRender : sourceRenders)
+    {
+      sourceRender.Submit();
+    }
+
+    world->SubmitVelocity(gravityRender);
+    for (auto& forceRender : forceRenders)
+    {
+      world->SubmitVelocity(forceRender);
+    }
+
+    world->Step(params);
+
+    if ((i + 1) % scene.OutputInterval == 0)
+    {
+      int frame = (i + 1) / scene.OutputInterval;
+      device.Handle().waitIdle();
+
+      WriteVelocity(FrameName(output, "velocity", frame) + ".pfm",
+                    device,
+                    scene.Size,
+                    world->GetVelocity());
+      WritePhi(FrameName(output, "liquid_phi", frame) + ".pfm",
+               device,
+               scene.Size,
+               world->GetLiquidPhi());
+      WritePhi(FrameName(output, "solid_phi", frame) + ".pfm",
+               device,
+               scene.Size,
+               world->GetSolidPhi());
+      if (density)
+      {
+        WriteDensity(FrameName(output, "density", frame) + ".ppm", device, scene.Size, *density);
+      }
+    }
+
+    device.Handle().waitIdle();
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Step " << i + 1 << "/" << scene.Steps << " "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+              << "ms" << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::cout << "Usage: " << argv[0] << " scene_file output_directory [--validation]"
+              << std::endl;
+    return 1;
+  }
+
+  bool validation = argc > 3 && std::strcmp(argv[3], "--validation") == 0;
+
+  try
+  {
+    auto scene = LoadScene(argv[1]);
+
+    Renderer::Instance instance("Vortex2D Batch", {}, validation);
+    Renderer::Device device(instance, validation);
+
+    Run(device, scene, argv[2]);
+  }
+  catch (const std::exception& error)
+  {
+    std::cout << "exception: " << error.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
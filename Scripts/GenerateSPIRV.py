@@ -9,17 +9,25 @@ parser.add_argument('files', metavar='files', nargs='+', help='list of glsl file
 parser.add_argument('--output', action='store', dest='output', help='output file')
 parser.add_argument('--compiler', action='store', dest='compiler', help='location of spirv compiler')
 parser.add_argument('--vulkan_version', action='store', dest='version', help='vulkan version')
+parser.add_argument('--variant_suffix', action='store', dest='variant_suffix', help='name suffix of the variants')
+parser.add_argument('--variant_define', action='store', dest='variant_define', help='macro defined in the variants')
+parser.add_argument('--variant_files', metavar='files', nargs='*', default=[], help='list of glsl files also compiled as a variant')
 
 args = parser.parse_args()
 
 # create temp dir
 dirpath = tempfile.mkdtemp()
 
-def genCArray(file):
-  basename = ntpath.basename(file).replace('.', '_')
+def genName(file, suffix):
+  name, extension = ntpath.basename(file).rsplit('.', 1)
+  return name + suffix + '_' + extension
+
+def genCArray(file, suffix = '', defines = []):
+  basename = genName(file, suffix)
   temp_file = dirpath + '/' + basename + '.txt'
   try:
-    subprocess.check_output([args.compiler,'--target-env', 'vulkan' + args.version, '-V',file,'-x','-o',temp_file]).decode('utf-8')
+    defines = ['-D' + define for define in defines]
+    subprocess.check_output([args.compiler,'--target-env', 'vulkan' + args.version, '-V'] + defines + [file,'-x','-o',temp_file]).decode('utf-8')
   except subprocess.CalledProcessError as e:
     print(e.output)
   content = None
@@ -29,8 +37,8 @@ def genCArray(file):
   spirv = 'Vortex2D::Renderer::SpirvBinary ' + basename + '(_' + basename + ');\n'
   return array + spirv
 
-def genCArrayDef(file):
-  basename = ntpath.basename(file).replace('.', '_')
+def genCArrayDef(file, suffix = ''):
+  basename = genName(file, suffix)
   return 'extern Vortex2D::Renderer::SpirvBinary ' + basename + ';\n'
 
 output = ntpath.basename(args.output)
@@ -55,6 +63,9 @@ namespace SPIRV
   for file in args.files:
     f.write(genCArrayDef(file))
 
+  for file in args.variant_files:
+    f.write(genCArrayDef(file, args.variant_suffix))
+
   f.write('''
 }
 }
@@ -80,6 +91,9 @@ namespace SPIRV
   for file in args.files:
     f.write(genCArray(file))
 
+  for file in args.variant_files:
+    f.write(genCArray(file, args.variant_suffix, [args.variant_define]))
+
   f.write('''
 }
 }
@@ -9,6 +9,8 @@
 #include "VariationalHelpers.h"
 #include "Verify.h"
 
+#include <cmath>
+
 using namespace Vortex2D::Renderer;
 using namespace Vortex2D::Fluid;
 
@@ -33,6 +35,7 @@ TEST(AdvectionTests, AdvectVelocity_Simple)
 
   Advection advection(*device, size, 0.01f, velocity, Velocity::InterpolationMode::Cubic);
   advection.AdvectVelocity();
+  velocity.Resolve();
 
   device->Queue().waitIdle();
 
@@ -59,12 +62,61 @@ TEST(AdvectionTests, AdvectVelocity_Complex)
 
   Advection advection(*device, size, 0.01f, velocity, Velocity::InterpolationMode::Cubic);
   advection.AdvectVelocity();
+  velocity.Resolve();
 
   device->Queue().waitIdle();
 
   CheckVelocity(*device, size, velocity, sim, 1e-5f);
 }
 
+TEST(AdvectionTests, AdvectVelocity_Swap)
+{
+  glm::ivec2 size(50);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(complex_boundary_phi);
+
+  AddParticles(size, sim, complex_boundary_phi);
+
+  sim.add_force(0.01f);
+  sim.advance(0.01f);
+
+  Velocity velocity(*device, size);
+  SetVelocity(*device, size, velocity, sim);
+
+  Velocity copiedVelocity(*device, size);
+  SetVelocity(*device, size, copiedVelocity, sim);
+
+  // Advecting from the output field gives the same result as copying back
+  Advection advection(*device, size, 0.01f, velocity, Velocity::InterpolationMode::Cubic);
+  advection.AdvectVelocity();
+  EXPECT_EQ(1u, velocity.Front());
+  advection.AdvectVelocity();
+  EXPECT_EQ(0u, velocity.Front());
+  advection.AdvectVelocity();
+  velocity.Resolve();
+  EXPECT_EQ(0u, velocity.Front());
+
+  Advection copiedAdvection(
+      *device, size, 0.01f, copiedVelocity, Velocity::InterpolationMode::Cubic);
+  for (int i = 0; i < 3; i++)
+  {
+    copiedAdvection.AdvectVelocity();
+    copiedVelocity.Resolve();
+  }
+
+  device->Queue().waitIdle();
+
+  Texture output(*device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { output.CopyFrom(commandBuffer, copiedVelocity); });
+  std::vector<glm::vec2> expected(size.x * size.y);
+  output.CopyTo(expected);
+
+  CheckVelocity(*device, size, velocity, expected, 0.0f);
+}
+
 TEST(AdvectionTests, Advect)
 {
   glm::ivec2 size(10);
@@ -109,6 +161,251 @@ TEST(AdvectionTests, Advect)
   ASSERT_EQ(128, pixels[pos.x + size.x * pos.y].x);
 }
 
+TEST(AdvectionTests, AdvectMultiple)
+{
+  glm::ivec2 size(10);
+
+  glm::vec2 vel(3.0f, 1.0f);
+  glm::ivec2 pos(3, 4);
+
+  Texture velocityInput(
+      *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Velocity velocity(*device, size);
+
+  std::vector<glm::vec2> velocityData(size.x * size.y, vel / glm::vec2(size));
+  velocityInput.CopyFrom(velocityData);
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { velocity.CopyFrom(commandBuffer, velocityInput); });
+
+  Texture fieldInput(
+      *device, size.x, size.y, vk::Format::eB8G8R8A8Unorm, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  // More fields than advected by one dispatch
+  Advection advection(*device, size, 1.0f, velocity, Velocity::InterpolationMode::Cubic);
+  std::vector<std::unique_ptr<Density>> fields;
+  for (int i = 0; i < 5; i++)
+  {
+    fields.push_back(std::make_unique<Density>(*device, size, vk::Format::eB8G8R8A8Unorm));
+
+    std::vector<glm::u8vec4> fieldData(size.x * size.y);
+    fieldData[pos.x + size.x * pos.y].x = static_cast<uint8_t>(100 + i);
+    fieldInput.CopyFrom(fieldData);
+
+    device->Execute(
+        [&](vk::CommandBuffer commandBuffer) { fields[i]->CopyFrom(commandBuffer, fieldInput); });
+
+    advection.AdvectBind(*fields[i]);
+  }
+
+  advection.Advect();
+
+  device->Handle().waitIdle();
+
+  glm::ivec2 newPos = pos + glm::ivec2(vel);
+  for (int i = 0; i < 5; i++)
+  {
+    device->Execute(
+        [&](vk::CommandBuffer commandBuffer) { fieldInput.CopyFrom(commandBuffer, *fields[i]); });
+
+    std::vector<glm::u8vec4> pixels(fieldInput.GetWidth() * fieldInput.GetHeight());
+    fieldInput.CopyTo(pixels);
+
+    EXPECT_EQ(100 + i, pixels[newPos.x + size.x * newPos.y].x);
+  }
+}
+
+TEST(AdvectionTests, Advect_MacCormack)
+{
+  glm::ivec2 size(10);
+
+  glm::vec2 vel(3.0f, 1.0f);
+  glm::ivec2 pos(3, 4);
+
+  Texture velocityInput(
+      *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Velocity velocity(*device, size);
+
+  std::vector<glm::vec2> velocityData(size.x * size.y, vel / glm::vec2(size));
+  velocityInput.CopyFrom(velocityData);
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { velocity.CopyFrom(commandBuffer, velocityInput); });
+
+  Texture fieldInput(
+      *device, size.x, size.y, vk::Format::eB8G8R8A8Unorm, VMA_MEMORY_USAGE_CPU_ONLY);
+  Density field(*device, size, vk::Format::eB8G8R8A8Unorm);
+
+  std::vector<glm::u8vec4> fieldData(size.x * size.y);
+  fieldData[pos.x + size.x * pos.y].x = 128;
+  fieldInput.CopyFrom(fieldData);
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { field.CopyFrom(commandBuffer, fieldInput); });
+
+  Advection advection(*device, size, 1.0f, velocity, Velocity::InterpolationMode::Cubic);
+  advection.SetMode(AdvectionMode::MacCormack);
+  advection.AdvectBind(field);
+  advection.Advect();
+
+  device->Handle().waitIdle();
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { fieldInput.CopyFrom(commandBuffer, field); });
+
+  std::vector<glm::u8vec4> pixels(fieldInput.GetWidth() * fieldInput.GetHeight());
+  fieldInput.CopyTo(pixels);
+
+  // The limiter doesn't create new extrema
+  pos += glm::ivec2(vel);
+  for (int i = 0; i < size.x * size.y; i++)
+  {
+    EXPECT_EQ(i == pos.x + size.x * pos.y ? 128 : 0, pixels[i].x);
+  }
+}
+
+namespace
+{
+// Advect a gaussian in x by a uniform sub-cell velocity, and return the error
+// with the exact translated gaussian along a row
+float AdvectGaussianError(AdvectionMode mode)
+{
+  glm::ivec2 size(32);
+  const float shift = 0.3f;
+  const int steps = 20;
+
+  Texture velocityInput(
+      *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Velocity velocity(*device, size);
+
+  std::vector<glm::vec2> velocityData(size.x * size.y, glm::vec2(shift, 0.0f) / glm::vec2(size));
+  velocityInput.CopyFrom(velocityData);
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { velocity.CopyFrom(commandBuffer, velocityInput); });
+
+  auto gaussian = [](float x) { return 255.0f * std::exp(-(x - 10.0f) * (x - 10.0f) / 4.5f); };
+
+  Texture fieldInput(
+      *device, size.x, size.y, vk::Format::eB8G8R8A8Unorm, VMA_MEMORY_USAGE_CPU_ONLY);
+  Density field(*device, size, vk::Format::eB8G8R8A8Unorm);
+
+  std::vector<glm::u8vec4> fieldData(size.x * size.y);
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      fieldData[i + size.x * j].x = static_cast<uint8_t>(std::round(gaussian(i)));
+    }
+  }
+  fieldInput.CopyFrom(fieldData);
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { field.CopyFrom(commandBuffer, fieldInput); });
+
+  Advection advection(*device, size, 1.0f, velocity, Velocity::InterpolationMode::Cubic);
+  advection.SetMode(mode);
+  advection.AdvectBind(field);
+  for (int i = 0; i < steps; i++)
+  {
+    advection.Advect();
+  }
+
+  device->Handle().waitIdle();
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { fieldInput.CopyFrom(commandBuffer, field); });
+
+  std::vector<glm::u8vec4> pixels(size.x * size.y);
+  fieldInput.CopyTo(pixels);
+
+  float error = 0.0f;
+  int j = size.y / 2;
+  for (int i = 0; i < size.x; i++)
+  {
+    error += std::abs(pixels[i + size.x * j].x - gaussian(i - shift * steps));
+  }
+
+  return error;
+}
+}  // namespace
+
+TEST(AdvectionTests, Advect_MacCormackSubCell)
+{
+  // The correction reduces the diffusion of the interpolation
+  float semiLagrangianError = AdvectGaussianError(AdvectionMode::SemiLagrangian);
+  float macCormackError = AdvectGaussianError(AdvectionMode::MacCormack);
+
+  EXPECT_LT(macCormackError, semiLagrangianError);
+}
+
+TEST(AdvectionTests, AdvectVelocity_MacCormack)
+{
+  glm::ivec2 size(32);
+  const float shift = 0.3f;
+  const int steps = 20;
+
+  // Uniform u, and v varying along x only, so v is translated along x by u and
+  // u stays uniform
+  auto profile = [](float x) { return 0.1f * std::exp(-(x - 10.0f) * (x - 10.0f) / 4.5f); };
+
+  std::vector<glm::vec2> velocityData(size.x * size.y);
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      velocityData[i + size.x * j] = glm::vec2(shift, profile(i + 0.5f)) / glm::vec2(size);
+    }
+  }
+
+  Texture velocityInput(
+      *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  velocityInput.CopyFrom(velocityData);
+
+  auto advect = [&](AdvectionMode mode) {
+    Velocity velocity(*device, size);
+    device->Execute(
+        [&](vk::CommandBuffer commandBuffer) { velocity.CopyFrom(commandBuffer, velocityInput); });
+
+    Advection advection(*device, size, 1.0f, velocity, Velocity::InterpolationMode::Linear);
+    advection.SetMode(mode);
+    for (int i = 0; i < steps; i++)
+    {
+      advection.AdvectVelocity();
+    }
+    velocity.Resolve();
+
+    device->Handle().waitIdle();
+
+    Texture output(
+        *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+    device->Execute(
+        [&](vk::CommandBuffer commandBuffer) { output.CopyFrom(commandBuffer, velocity); });
+    std::vector<glm::vec2> pixels(size.x * size.y);
+    output.CopyTo(pixels);
+    return pixels;
+  };
+
+  auto semiLagrangian = advect(AdvectionMode::SemiLagrangian);
+  auto macCormack = advect(AdvectionMode::MacCormack);
+
+  float semiLagrangianError = 0.0f;
+  float macCormackError = 0.0f;
+  int j = size.y / 2;
+  for (int i = 0; i < size.x; i++)
+  {
+    std::size_t index = i + size.x * j;
+    float expected = profile(i + 0.5f - shift * steps) / size.x;
+
+    EXPECT_NEAR(shift / size.x, macCormack[index].x, 1e-6f);
+    semiLagrangianError += std::abs(semiLagrangian[index].y - expected);
+    macCormackError += std::abs(macCormack[index].y - expected);
+  }
+
+  // The correction reduces the diffusion of the interpolation
+  EXPECT_LT(macCormackError, semiLagrangianError);
+}
+
 TEST(AdvectionTests, ParticleAdvect)
 {
   glm::ivec2 size(50);
@@ -230,3 +527,72 @@ TEST(AdvectionTests, ParticleProject)
     EXPECT_NEAR(pos.y, outParticlesData[i].Position.y, 1e-5f);
   }
 }
+
+TEST(AdvectionTests, ParticleSubSteps)
+{
+  glm::ivec2 size(50);
+
+  // setup particles
+  Buffer<Particle> particles(*device, 8 * size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+  IndirectBuffer<DispatchParams> dispatchParams(*device, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  DispatchParams params(1);
+  CopyFrom(dispatchParams, params);
+
+  std::vector<Particle> particlesData(8 * size.x * size.y);
+  particlesData[0].Position = glm::vec2(20.0f, 10.5f);
+  CopyFrom(particles, particlesData);
+
+  // setup velocities, moving the particle 10 cells to the right
+  Texture velocityInput(
+      *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Velocity velocity(*device, size);
+
+  std::vector<glm::vec2> velocityData(size.x * size.y, glm::vec2(10.0f / size.x, 0.0f));
+  velocityInput.CopyFrom(velocityData);
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { velocity.CopyFrom(commandBuffer, velocityInput); });
+
+  // setup level set, a wall 6 cells wide around x = 25
+  Texture solidPhiInput(
+      *device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+
+  std::vector<float> solidPhiData(size.x * size.y);
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      solidPhiData[i + size.x * j] = std::abs(i - 25.0f) - 3.0f;
+    }
+  }
+  solidPhiInput.CopyFrom(solidPhiData);
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { solidPhi.CopyFrom(commandBuffer, solidPhiInput); });
+
+  Advection advection(*device, size, 1.0f, velocity, Velocity::InterpolationMode::Linear);
+  advection.AdvectParticleBind(particles, solidPhi, dispatchParams);
+
+  // A single step jumps over the wall
+  advection.AdvectParticles();
+  device->Handle().waitIdle();
+
+  std::vector<Particle> outParticlesData(size.x * size.y * 8);
+  CopyTo(particles, outParticlesData);
+
+  EXPECT_NEAR(30.0f, outParticlesData[0].Position.x, 1e-4f);
+  EXPECT_NEAR(10.5f, outParticlesData[0].Position.y, 1e-4f);
+
+  // Steps of one cell are stopped by the wall
+  CopyFrom(particles, particlesData);
+  advection.SetParticleSubSteps(1.0f, 16);
+  advection.AdvectParticles();
+  device->Handle().waitIdle();
+
+  CopyTo(particles, outParticlesData);
+
+  EXPECT_NEAR(22.0f, outParticlesData[0].Position.x, 0.1f);
+  EXPECT_NEAR(10.5f, outParticlesData[0].Position.y, 1e-4f);
+}
@@ -10,6 +10,8 @@
 #include <Vortex2D/Engine/LevelSet.h>
 #include <Vortex2D/Renderer/Shapes.h>
 
+#include <algorithm>
+
 using namespace Vortex2D::Renderer;
 using namespace Vortex2D::Fluid;
 
@@ -113,6 +115,98 @@ TEST(LevelSetTests, ComplexCircles)
   CheckDifference(outTexture, complex_boundary_phi, 1.0f);
 }
 
+TEST(LevelSetTests, NarrowBand)
+{
+  glm::ivec2 size(50);
+  const int iterations = 10;
+
+  LevelSet levelSet(*device, size, iterations);
+  Texture outTexture(*device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Ellipse circle(*device, glm::vec2{rad0} * glm::vec2(size));
+  circle.Position = glm::vec2(c0[0], c0[1]) * glm::vec2(size) - glm::vec2(0.5f);
+  circle.Colour = glm::vec4(0.5f);
+
+  Clear clear(glm::vec4(-0.5f));
+
+  levelSet.Record({clear, circle}).Submit();
+  levelSet.Reinitialise();
+
+  device->Handle().waitIdle();
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { outTexture.CopyFrom(commandBuffer, levelSet); });
+
+  std::vector<float> pixels(size.x * size.y);
+  outTexture.CopyTo(pixels);
+
+  // Distances are correct in the band and clamped to its width outside
+  for (int j = 0; j < size.y; j++)
+  {
+    for (int i = 0; i < size.x; i++)
+    {
+      Vec2f pos((i + 1.0f) / size.x, (j + 1.0f) / size.x);
+      float value = size.x * boundary_phi(pos);
+      float readerValue = pixels[i + j * size.x];
+
+      EXPECT_LE(std::abs(readerValue), iterations) << "Mismatch at " << i << ", " << j;
+      if (std::abs(value) < iterations - 2)
+      {
+        EXPECT_LT(std::abs(value - readerValue), 1.0f) << "Mismatch at " << i << ", " << j;
+      }
+    }
+  }
+}
+
+TEST(LevelSetTests, ReinitializeClamp)
+{
+  glm::ivec2 size(50);
+
+  LevelSet levelSet(*device, size);
+  Texture outTexture(*device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Ellipse circle(*device, glm::vec2{rad0} * glm::vec2(size));
+  circle.Position = glm::vec2(c0[0], c0[1]) * glm::vec2(size) - glm::vec2(0.5f);
+  circle.Colour = glm::vec4(0.5f);
+
+  Clear clear(glm::vec4(-0.5f));
+
+  // Changing the band also changes the value the far cells are set to
+  const int iterations = 5;
+  levelSet.SetReinitializeIterations(iterations);
+  levelSet.Record({clear, circle}).Submit();
+  levelSet.Reinitialise();
+
+  device->Handle().waitIdle();
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { outTexture.CopyFrom(commandBuffer, levelSet); });
+
+  std::vector<float> pixels(size.x * size.y);
+  outTexture.CopyTo(pixels);
+
+  int clampedCount = 0;
+  for (int j = 0; j < size.y; j++)
+  {
+    for (int i = 0; i < size.x; i++)
+    {
+      Vec2f pos((i + 1.0f) / size.x, (j + 1.0f) / size.x);
+      float value = size.x * boundary_phi(pos);
+      float readerValue = pixels[i + j * size.x];
+
+      // Cells beyond the band keep their sign and are set to the band width
+      if (std::abs(value) > iterations + 1)
+      {
+        EXPECT_EQ(static_cast<float>(value < 0.0f ? -iterations : iterations), readerValue)
+            << "Mismatch at " << i << ", " << j;
+        clampedCount++;
+      }
+    }
+  }
+
+  EXPECT_GT(clampedCount, 0);
+}
+
 TEST(LevelSetTests, Extrapolate)
 {
   glm::ivec2 size(50);
@@ -176,3 +270,139 @@ TEST(LevelSetTests, ShrinkWrap)
   std::vector<float> outData(size.x * size.y, -0.5f);
   CheckTexture(outData, outTexture);
 }
+
+namespace
+{
+std::vector<float> ReinitialisedCircle(LevelSet& levelSet, int iterations)
+{
+  glm::ivec2 size(levelSet.GetWidth(), levelSet.GetHeight());
+  Texture outTexture(*device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Ellipse circle(*device, glm::vec2{rad0} * glm::vec2(size));
+  circle.Position = glm::vec2(c0[0], c0[1]) * glm::vec2(size) - glm::vec2(0.5f);
+  circle.Colour = glm::vec4(0.5f);
+
+  Clear clear(glm::vec4(-0.5f));
+
+  levelSet.SetReinitializeIterations(iterations);
+  levelSet.Record({clear, circle}).Submit();
+  levelSet.Reinitialise();
+
+  device->Handle().waitIdle();
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { outTexture.CopyFrom(commandBuffer, levelSet); });
+
+  std::vector<float> pixels(size.x * size.y);
+  outTexture.CopyTo(pixels);
+  return pixels;
+}
+
+std::vector<float> ReadLevelSet(LevelSet& levelSet)
+{
+  Texture outTexture(*device,
+                     levelSet.GetWidth(),
+                     levelSet.GetHeight(),
+                     vk::Format::eR32Sfloat,
+                     VMA_MEMORY_USAGE_CPU_ONLY);
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { outTexture.CopyFrom(commandBuffer, levelSet); });
+
+  std::vector<float> pixels(levelSet.GetWidth() * levelSet.GetHeight());
+  outTexture.CopyTo(pixels);
+  return pixels;
+}
+}  // namespace
+
+TEST(LevelSetTests, ExtrapolateBand)
+{
+  glm::ivec2 size(50);
+  const int iterations = 5;
+
+  Texture localSolidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Texture solidPhi(*device, size.x, size.y, vk::Format::eR32Sfloat);
+
+  // Solid square straddling the circle
+  std::vector<float> solidData(size.x * size.y, 1.0);
+  DrawSquare(size.x, size.y, solidData, glm::vec2(5.0f), glm::vec2(20.0f), -1.0f);
+  localSolidPhi.CopyFrom(solidData);
+
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { solidPhi.CopyFrom(commandBuffer, localSolidPhi); });
+
+  LevelSet liquidPhi(*device, size);
+  liquidPhi.ExtrapolateBind(solidPhi);
+
+  auto before = ReinitialisedCircle(liquidPhi, iterations);
+
+  liquidPhi.Extrapolate();
+  device->Handle().waitIdle();
+
+  auto after = ReadLevelSet(liquidPhi);
+
+  int changedCount = 0;
+  for (int j = 0; j < size.y - 1; j++)
+  {
+    for (int i = 0; i < size.x - 1; i++)
+    {
+      int index = i + j * size.x;
+      float w = 0.25f * (solidData[index] + solidData[index + 1] + solidData[index + size.x] +
+                         solidData[index + 1 + size.x]);
+      float expected = before[index] < 0.5f && w < 0.0f ? -0.5f : before[index];
+
+      // Cells closer than the band width are in the band tiles, deeper ones
+      // may be left as they are
+      if (std::abs(before[index]) < iterations)
+      {
+        EXPECT_FLOAT_EQ(expected, after[index]) << "Mismatch at " << i << ", " << j;
+      }
+      else if (after[index] != before[index])
+      {
+        EXPECT_FLOAT_EQ(expected, after[index]) << "Mismatch at " << i << ", " << j;
+      }
+
+      if (expected != before[index])
+      {
+        changedCount++;
+      }
+    }
+  }
+
+  EXPECT_GT(changedCount, 0);
+}
+
+TEST(LevelSetTests, ShrinkWrapBand)
+{
+  glm::ivec2 size(50);
+  const int iterations = 5;
+
+  LevelSet levelSet(*device, size);
+
+  auto before = ReinitialisedCircle(levelSet, iterations);
+
+  levelSet.ShrinkWrap();
+  device->Handle().waitIdle();
+
+  auto after = ReadLevelSet(levelSet);
+
+  for (int j = 1; j < size.y - 1; j++)
+  {
+    for (int i = 1; i < size.x - 1; i++)
+    {
+      int index = i + j * size.x;
+      float average = 0.25f * (before[index + 1] + before[index - 1] + before[index + size.x] +
+                               before[index - size.x]);
+      float expected = std::min(before[index], average);
+
+      if (std::abs(before[index]) < iterations)
+      {
+        EXPECT_NEAR(expected, after[index], 1e-5f) << "Mismatch at " << i << ", " << j;
+      }
+      else if (after[index] != before[index])
+      {
+        EXPECT_NEAR(expected, after[index], 1e-5f) << "Mismatch at " << i << ", " << j;
+      }
+    }
+  }
+}
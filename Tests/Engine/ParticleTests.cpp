@@ -6,14 +6,17 @@
 #include "VariationalHelpers.h"
 #include "Verify.h"
 
+#include <cmath>
 #include <glm/gtx/io.hpp>
 #include <numeric>
 #include <random>
 
+#include <Vortex2D/Engine/Emitters.h>
 #include <Vortex2D/Engine/LevelSet.h>
 #include <Vortex2D/Engine/Particles.h>
 #include <Vortex2D/Engine/PrefixScan.h>
 #include <Vortex2D/Renderer/Shapes.h>
+#include <Vortex2D/Renderer/Timer.h>
 
 using namespace Vortex2D::Renderer;
 using namespace Vortex2D::Fluid;
@@ -61,6 +64,55 @@ void PrintPrefixBuffer(const glm::ivec2& size, Buffer<int>& buffer)
   std::cout << std::endl;
 }
 
+std::vector<Particle> ReadParticles(ParticleCount& particleCount, const glm::ivec2& size)
+{
+  // With APIC, the buffer is larger than the particles and ends with their gradients
+  auto count = particleCount.GetParticles().Size() / sizeof(Particle);
+  Buffer<Particle> localParticles(*device, count, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    localParticles.CopyFrom(commandBuffer, particleCount.GetParticles());
+  });
+
+  std::vector<Particle> particles(count);
+  CopyTo(localParticles, particles);
+  particles.resize(8 * size.x * size.y);
+  return particles;
+}
+
+std::vector<glm::vec4> ReadAffine(ParticleCount& particleCount, const glm::ivec2& size)
+{
+  // The gradients of the u (xy) and v (zw) components follow all the particles
+  auto count = particleCount.GetParticles().Size() / sizeof(glm::vec4);
+  Buffer<glm::vec4> localAffine(*device, count, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    localAffine.CopyFrom(commandBuffer, particleCount.GetParticles());
+  });
+
+  std::vector<glm::vec4> affine(count);
+  CopyTo(localAffine, affine);
+
+  auto capacity = 8 * size.x * size.y;
+  return std::vector<glm::vec4>(affine.begin() + capacity, affine.begin() + 2 * capacity);
+}
+
+// Bilinear interpolation of one velocity component (x) and its gradient (yz),
+// as in ParticleFromGrid.comp
+glm::vec3 BilinearVelocity(const glm::ivec2& size,
+                           const std::vector<glm::vec2>& velocity,
+                           const glm::vec2& xy,
+                           int component)
+{
+  glm::ivec2 ij = glm::clamp(glm::ivec2(glm::floor(xy)), glm::ivec2(0), size - glm::ivec2(2));
+  glm::vec2 f = glm::clamp(xy - glm::vec2(ij), 0.0f, 1.0f);
+
+  auto value = [&](int i, int j) { return velocity[ij.x + i + (ij.y + j) * size.x][component]; };
+  float v00 = value(0, 0), v10 = value(1, 0), v01 = value(0, 1), v11 = value(1, 1);
+
+  return {glm::mix(glm::mix(v00, v10, f.x), glm::mix(v01, v11, f.x), f.y),
+          glm::mix(v10 - v00, v11 - v01, f.y),
+          glm::mix(v01 - v00, v11 - v10, f.x)};
+}
+
 void PrintPrefixVector(const std::vector<int>& data)
 {
   for (auto value : data)
@@ -209,8 +261,7 @@ TEST(ParticleTests, ParticleDelete)
   ASSERT_EQ(2, particleCount.GetTotalCount());
 
   // Read particles
-  std::vector<Particle> outParticlesData(size.x * size.y * 8);
-  CopyTo(particles, outParticlesData);
+  auto outParticlesData = ReadParticles(particleCount, size);
 
   // We don't know the order of particles in the same grid position
   EXPECT_TRUE(outParticlesData[0].Position == particlesData[0].Position ||
@@ -219,6 +270,73 @@ TEST(ParticleTests, ParticleDelete)
               outParticlesData[1].Position == particlesData[2].Position);
 }
 
+TEST(ParticleTests, ParticleDoubleBuffer)
+{
+  glm::ivec2 size(20);
+
+  std::vector<Particle> particlesData(8 * size.x * size.y);
+  particlesData[0].Position = glm::vec2(3.4f, 2.3f);
+  particlesData[1].Position = glm::vec2(13.4f, 16.7f);
+  int numParticles = 2;
+
+  Buffer<Particle> particles(*device, 8 * size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+  CopyFrom(particles, particlesData);
+
+  ParticleCount particleCount(
+      *device, size, particles, Velocity::InterpolationMode::Cubic, {numParticles});
+  ASSERT_EQ(0, particleCount.GetParticlesIndex());
+
+  // Each scan buckets the particles in the other buffer
+  for (int i = 1; i <= 3; i++)
+  {
+    particleCount.Scan();
+    device->Queue().waitIdle();
+
+    EXPECT_EQ(i % 2, particleCount.GetParticlesIndex());
+    ASSERT_EQ(numParticles, particleCount.GetTotalCount());
+
+    auto outParticlesData = ReadParticles(particleCount, size);
+    EXPECT_EQ(particlesData[0].Position, outParticlesData[0].Position);
+    EXPECT_EQ(particlesData[1].Position, outParticlesData[1].Position);
+  }
+}
+
+TEST(ParticleTests, ParticleGrow)
+{
+  glm::ivec2 size(20);
+
+  Buffer<Particle> particles(*device, 50);
+  ParticleCount particleCount(*device, size, particles, Velocity::InterpolationMode::Cubic);
+  ASSERT_EQ(50u, particleCount.GetCapacity());
+
+  // Add 4 particles per cell in 100 cells
+  IntRectangle rect(*device, {10, 10});
+  rect.Colour = glm::vec4(4);
+
+  particleCount.Record({rect}).Submit();
+
+  // The particles past the capacity are dropped
+  particleCount.Scan();
+  device->Queue().waitIdle();
+
+  ASSERT_EQ(50, particleCount.GetTotalCount());
+
+  // Growing spawns them again
+  ASSERT_TRUE(particleCount.Grow());
+  device->Queue().waitIdle();
+
+  EXPECT_EQ(800u, particleCount.GetCapacity());
+  EXPECT_EQ(800 * sizeof(Particle), particleCount.GetParticles(0).Size());
+  EXPECT_EQ(800 * sizeof(Particle), particleCount.GetParticles(1).Size());
+  ASSERT_EQ(400, particleCount.GetTotalCount());
+
+  particleCount.Scan();
+  device->Queue().waitIdle();
+
+  EXPECT_FALSE(particleCount.Grow());
+  EXPECT_EQ(400, particleCount.GetTotalCount());
+}
+
 TEST(ParticleTests, ParticleClamp)
 {
   glm::ivec2 size(20);
@@ -265,8 +383,7 @@ TEST(ParticleTests, ParticleSpawn)
   ASSERT_EQ(4, particleNum);
 
   // Read particles
-  std::vector<Particle> outParticlesData(size.x * size.y * 8);
-  CopyTo(particles, outParticlesData);
+  auto outParticlesData = ReadParticles(particleCount, size);
 
   glm::ivec2 particlePos(10, 10);
   EXPECT_EQ(glm::ivec2(outParticlesData[0].Position), particlePos);
@@ -290,6 +407,213 @@ TEST(ParticleTests, ParticleSpawn)
   }
 }
 
+TEST(ParticleTests, NarrowBand)
+{
+  glm::ivec2 size(20);
+
+  Buffer<Particle> particles(*device, 8 * size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+  ParticleCount particleCount(*device, size, particles, Velocity::InterpolationMode::Cubic);
+
+  // Liquid below row 10, the interior of a band of 3 cells is below row 7
+  std::vector<float> data(size.x * size.y);
+  for (int j = 0; j < size.y; j++)
+  {
+    for (int i = 0; i < size.x; i++)
+    {
+      data[i + j * size.x] = j < 10 ? j - 10.0f : 1.0f;
+    }
+  }
+
+  LevelSet phi(*device, size);
+  Texture localPhi(*device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    localPhi.CopyFrom(data);
+    phi.CopyFrom(commandBuffer, localPhi);
+  });
+
+  particleCount.NarrowBandBind(phi, 3.0f);
+
+  // Particles everywhere but in the band
+  IntRectangle interior(*device, {20, 7});
+  interior.Colour = glm::ivec4(4);
+  IntRectangle outside(*device, {20, 11});
+  outside.Position = glm::vec2(0.0f, 9.0f);
+  outside.Colour = glm::ivec4(4);
+
+  particleCount.Record({interior, outside}).Submit();
+
+  // The interior particles are removed and rows 7 and 8 are resampled
+  particleCount.Scan();
+  device->Queue().waitIdle();
+
+  ASSERT_EQ(13 * 20 * 4, particleCount.GetTotalCount());
+
+  auto outParticlesData = ReadParticles(particleCount, size);
+  for (int i = 0; i < 2 * 20 * 4; i++)
+  {
+    EXPECT_GE(outParticlesData[i].Position.y, 7.0f);
+    EXPECT_LT(outParticlesData[i].Position.y, 9.0f);
+    EXPECT_TRUE(std::isnan(outParticlesData[i].Velocity.x));
+  }
+
+  // The interior keeps its level set
+  particleCount.LevelSetBind(phi);
+  particleCount.Phi();
+  device->Queue().waitIdle();
+
+  Texture outTexture(*device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { outTexture.CopyFrom(commandBuffer, phi); });
+
+  std::vector<float> outData(size.x * size.y);
+  outTexture.CopyTo(outData);
+  for (int i = 0; i < 7 * size.x; i++)
+  {
+    EXPECT_FLOAT_EQ(data[i], outData[i]);
+  }
+}
+
+TEST(ParticleTests, Emitters)
+{
+  glm::ivec2 size(20);
+
+  Buffer<Particle> particles(*device, 8 * size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+  ParticleCount particleCount(*device, size, particles, Velocity::InterpolationMode::Cubic);
+  ParticleEmitters emitters(*device, size, particleCount);
+
+  // 2 particles per step in 4 cells
+  ParticleEmitter source;
+  source.Position = glm::vec2(5.0f);
+  source.Size = glm::vec2(1.0f);
+  source.Velocity = glm::vec2(1.0f, -2.0f);
+  source.Rate = 2.0f;
+  source.Shape = EmitterShape::Rectangle;
+  int sourceId = emitters.Add(source);
+
+  // 1 particle every other step in 4 cells, for 2 steps
+  ParticleEmitter shortSource;
+  shortSource.Position = glm::vec2(15.0f);
+  shortSource.Size = glm::vec2(1.0f);
+  shortSource.Velocity = glm::vec2(0.0f);
+  shortSource.Rate = 0.5f;
+  shortSource.Shape = EmitterShape::Circle;
+  emitters.Add(shortSource, 2);
+
+  emitters.Emit();
+  particleCount.Scan();
+  device->Queue().waitIdle();
+
+  ASSERT_EQ(8, particleCount.GetTotalCount());
+
+  ParticleStats stats;
+  ASSERT_TRUE(particleCount.GetStats(stats));
+  EXPECT_EQ(0, stats.Dropped);
+  EXPECT_EQ(2, stats.MinPerCell);
+  EXPECT_EQ(2, stats.MaxPerCell);
+
+  auto outParticlesData = ReadParticles(particleCount, size);
+  for (int i = 0; i < 8; i++)
+  {
+    // Velocities are stored relative to the grid width
+    EXPECT_NEAR(1.0f / size.x, outParticlesData[i].Velocity.x, 1e-6f);
+    EXPECT_NEAR(-2.0f / size.x, outParticlesData[i].Velocity.y, 1e-6f);
+  }
+
+  emitters.Emit();
+  particleCount.Scan();
+  device->Queue().waitIdle();
+
+  ASSERT_EQ(20, particleCount.GetTotalCount());
+  ASSERT_EQ(1u, emitters.Size());
+
+  // Replace the source with a sink
+  emitters.Remove(sourceId);
+
+  ParticleEmitter sink = source;
+  sink.Rate = -8.0f;
+  emitters.Add(sink);
+
+  emitters.Emit();
+  particleCount.Scan();
+  device->Queue().waitIdle();
+
+  ASSERT_EQ(4, particleCount.GetTotalCount());
+}
+
+std::vector<float> SpawnParticlesPhi(const glm::ivec2& size, ParticleLayout layout)
+{
+  GenericBuffer particles(*device,
+                          vk::BufferUsageFlagBits::eStorageBuffer,
+                          VMA_MEMORY_USAGE_GPU_ONLY,
+                          8 * size.x * size.y * GetBytesPerParticle(layout));
+  ParticleCount particleCount(*device,
+                              size,
+                              particles,
+                              Velocity::InterpolationMode::Cubic,
+                              {0},
+                              1.0f,
+                              DefaultParticleSize(),
+                              layout);
+  particleCount.SetDeterministic(true, 1);
+
+  IntRectangle rect(*device, {6, 4});
+  rect.Position = glm::vec2(5.0f, 7.0f);
+  rect.Colour = glm::ivec4(4);
+
+  // Spawn, then bucket the spawned particles
+  particleCount.Record({rect}).Submit();
+  particleCount.Scan();
+  particleCount.Scan();
+  device->Queue().waitIdle();
+
+  EXPECT_EQ(96, particleCount.GetTotalCount());
+
+  LevelSet phi(*device, size);
+  particleCount.LevelSetBind(phi);
+  particleCount.Phi();
+  device->Handle().waitIdle();
+
+  Texture outTexture(*device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { outTexture.CopyFrom(commandBuffer, phi); });
+
+  std::vector<float> pixels(size.x * size.y);
+  outTexture.CopyTo(pixels);
+  return pixels;
+}
+
+TEST(ParticleTests, ParticleLayouts)
+{
+  glm::ivec2 size(20);
+
+  auto interleaved = SpawnParticlesPhi(size, ParticleLayout::Interleaved);
+  auto separate = SpawnParticlesPhi(size, ParticleLayout::Separate);
+  auto compact = SpawnParticlesPhi(size, ParticleLayout::Compact);
+
+  for (std::size_t i = 0; i < interleaved.size(); i++)
+  {
+    EXPECT_FLOAT_EQ(interleaved[i], separate[i]);
+    // Positions are quantized to (size + 2) / 65535
+    EXPECT_NEAR(interleaved[i], compact[i], 1e-3f);
+  }
+
+  // The compact positions are too coarse on large grids
+  glm::ivec2 largeSize(256);
+  GenericBuffer particles(*device,
+                          vk::BufferUsageFlagBits::eStorageBuffer,
+                          VMA_MEMORY_USAGE_GPU_ONLY,
+                          GetBytesPerParticle(ParticleLayout::Compact));
+  EXPECT_THROW(ParticleCount(*device,
+                             largeSize,
+                             particles,
+                             Velocity::InterpolationMode::Cubic,
+                             {0},
+                             1.0f,
+                             DefaultParticleSize(),
+                             ParticleLayout::Compact),
+               std::runtime_error);
+}
+
 TEST(ParticleTests, ParticleAddDelete)
 {
   glm::ivec2 size(20);
@@ -320,8 +644,7 @@ TEST(ParticleTests, ParticleAddDelete)
   device->Queue().waitIdle();
 
   // Read particles
-  std::vector<Particle> outParticlesData(size.x * size.y * 8);
-  CopyTo(particles, outParticlesData);
+  auto outParticlesData = ReadParticles(particleCount, size);
 
   ASSERT_EQ(4, particleCount.GetTotalCount());
 
@@ -407,6 +730,90 @@ TEST(ParticleTests, Phi)
   CheckPhi(size, sim, outTexture);
 }
 
+TEST(ParticleTests, Phi_Average)
+{
+  glm::ivec2 size(20);
+  glm::vec2 centre(10.0f);
+  float radius = 6.0f;
+
+  // 4 particles in each cell of a disk
+  std::vector<glm::vec2> offsets = {
+      {0.25f, 0.25f}, {0.75f, 0.25f}, {0.25f, 0.75f}, {0.75f, 0.75f}};
+  std::vector<Particle> particlesData;
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      for (auto& offset : offsets)
+      {
+        Particle particle;
+        particle.Position = glm::vec2(i, j) + offset;
+        if (glm::distance(particle.Position, centre) < radius)
+        {
+          particlesData.push_back(particle);
+        }
+      }
+    }
+  }
+
+  int numParticles = static_cast<int>(particlesData.size());
+  particlesData.resize(8 * size.x * size.y);
+
+  Buffer<Particle> particles(*device, 8 * size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+  CopyFrom(particles, particlesData);
+
+  ParticleCount particleCount(*device,
+                              size,
+                              particles,
+                              Velocity::InterpolationMode::Cubic,
+                              {numParticles},
+                              1.0f,
+                              DefaultParticleSize(),
+                              ParticleLayout::Interleaved,
+                              ParticleToGridMode::Gather,
+                              ParticleTransfer::PicFlip,
+                              ParticleCellOrder::RowMajor,
+                              ParticlePhiMode::Average);
+
+  particleCount.Scan();
+  device->Handle().waitIdle();
+
+  LevelSet phi(*device, size);
+
+  particleCount.LevelSetBind(phi);
+  particleCount.Phi();
+  device->Handle().waitIdle();
+
+  Texture outTexture(*device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { outTexture.CopyFrom(commandBuffer, phi); });
+
+  std::vector<float> pixels(size.x * size.y);
+  outTexture.CopyTo(pixels);
+
+  // The surface is close to the disk
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      float value = pixels[i + j * size.x];
+      float distance = glm::distance(glm::vec2(i, j) + 0.5f, centre) - radius;
+      if (distance < -1.0f)
+      {
+        EXPECT_LT(value, 0.0f) << "Mismatch at " << i << "," << j;
+      }
+      else if (distance > 1.0f)
+      {
+        EXPECT_GT(value, 0.0f) << "Mismatch at " << i << "," << j;
+      }
+      else
+      {
+        EXPECT_NEAR(value, distance, 1.0f) << "Mismatch at " << i << "," << j;
+      }
+    }
+  }
+}
+
 TEST(ParticleTests, FromGrid_PIC)
 {
   // Small size otherwise test is too slow (due to O(n^2) search)
@@ -464,8 +871,7 @@ TEST(ParticleTests, FromGrid_PIC)
 
   // TODO check valid
 
-  std::vector<Particle> outParticlesData(size.x * size.y * 8);
-  CopyTo(particles, outParticlesData);
+  auto outParticlesData = ReadParticles(particleCount, size);
 
   for (std::size_t i = 0; i < sim.particles.size(); i++)
   {
@@ -547,8 +953,7 @@ TEST(ParticleTests, FromGrid_FLIP)
 
   // TODO check valid
 
-  std::vector<Particle> outParticlesData(size.x * size.y * 8);
-  CopyTo(particles, outParticlesData);
+  auto outParticlesData = ReadParticles(particleCount, size);
 
   for (std::size_t i = 0; i < sim.particles.size(); i++)
   {
@@ -570,7 +975,198 @@ TEST(ParticleTests, FromGrid_FLIP)
   }
 }
 
-TEST(ParticleTests, ToGrid)
+TEST(ParticleTests, FromGrid_APIC)
+{
+  // Small size otherwise test is too slow (due to O(n^2) search)
+  glm::ivec2 size(20);
+
+  // setup FluidSim
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+
+  AddParticles(size, sim, boundary_phi);
+
+  sim.advance(0.01f);
+  sim.update_from_grid(1.0f);
+
+  // setup ParticleCount, the buffer also holds the velocity gradients
+  auto bytesPerParticle = GetBytesPerParticle(ParticleLayout::Interleaved, ParticleTransfer::Apic);
+  auto numParticles = 8 * size.x * size.y * bytesPerParticle / sizeof(Particle);
+  Buffer<Particle> particles(*device, numParticles, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  std::vector<Particle> particlesData;
+  for (std::size_t p = 0; p < sim.particles.size(); p++)
+  {
+    Particle particle;
+    particle.Position = glm::vec2(sim.particles[p][0] * size.x, sim.particles[p][1] * size.x);
+    particle.Velocity = glm::vec2(0.0f);
+    particlesData.push_back(particle);
+  }
+  particlesData.resize(numParticles);
+  CopyFrom(particles, particlesData);
+
+  ParticleCount particleCount(*device,
+                              size,
+                              particles,
+                              Velocity::InterpolationMode::Cubic,
+                              {(int)sim.particles.size()},
+                              0.0f,
+                              DefaultParticleSize(),
+                              ParticleLayout::Interleaved,
+                              ParticleToGridMode::Gather,
+                              ParticleTransfer::Apic);
+
+  particleCount.Scan();
+  device->Handle().waitIdle();
+
+  ASSERT_EQ(sim.particles.size(), particleCount.GetTotalCount());
+
+  // FromGrid test, APIC doesn't need the velocity difference
+  Velocity velocity(*device, size, false);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  SetVelocity(*device, size, velocity, sim);
+
+  std::vector<glm::vec2> velocityData(size.x * size.y);
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      velocityData[i + size.x * j] = glm::vec2(sim.u(i, j), sim.v(i, j));
+    }
+  }
+
+  particleCount.VelocitiesBind(velocity, valid);
+  particleCount.TransferFromGrid();
+  device->Handle().waitIdle();
+
+  // Verify particle velocities and gradients are the bilinear ones, even with
+  // the cubic interpolation mode
+  auto outParticlesData = ReadParticles(particleCount, size);
+  auto outAffineData = ReadAffine(particleCount, size);
+
+  for (std::size_t i = 0; i < sim.particles.size(); i++)
+  {
+    glm::vec2 pos = outParticlesData[i].Position;
+    auto u = BilinearVelocity(size, velocityData, pos - glm::vec2(0.0f, 0.5f), 0);
+    auto v = BilinearVelocity(size, velocityData, pos - glm::vec2(0.5f, 0.0f), 1);
+
+    EXPECT_NEAR(u.x, outParticlesData[i].Velocity.x, 1e-5f);
+    EXPECT_NEAR(v.x, outParticlesData[i].Velocity.y, 1e-5f);
+    EXPECT_NEAR(u.y, outAffineData[i].x, 1e-5f);
+    EXPECT_NEAR(u.z, outAffineData[i].y, 1e-5f);
+    EXPECT_NEAR(v.y, outAffineData[i].z, 1e-5f);
+    EXPECT_NEAR(v.z, outAffineData[i].w, 1e-5f);
+  }
+
+  EXPECT_THROW(velocity.D(), std::runtime_error);
+}
+
+TEST(ParticleTests, APIC_RoundTrip)
+{
+  glm::ivec2 size(20);
+
+  FluidSim sim;
+  sim.initialize(1.0f, size.x, size.y);
+  sim.set_boundary(boundary_phi);
+  AddParticles(size, sim, boundary_phi);
+
+  auto bytesPerParticle = GetBytesPerParticle(ParticleLayout::Interleaved, ParticleTransfer::Apic);
+  auto numParticles = 8 * size.x * size.y * bytesPerParticle / sizeof(Particle);
+  Buffer<Particle> particles(*device, numParticles, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  std::vector<Particle> particlesData;
+  for (std::size_t p = 0; p < sim.particles.size(); p++)
+  {
+    Particle particle;
+    particle.Position = glm::vec2(sim.particles[p][0] * size.x, sim.particles[p][1] * size.x);
+    particle.Velocity = glm::vec2(0.0f);
+    particlesData.push_back(particle);
+  }
+  particlesData.resize(numParticles);
+  CopyFrom(particles, particlesData);
+
+  ParticleCount particleCount(*device,
+                              size,
+                              particles,
+                              Velocity::InterpolationMode::Cubic,
+                              {(int)sim.particles.size()},
+                              0.0f,
+                              DefaultParticleSize(),
+                              ParticleLayout::Interleaved,
+                              ParticleToGridMode::Gather,
+                              ParticleTransfer::Apic);
+
+  particleCount.Scan();
+  device->Handle().waitIdle();
+
+  // Rigid rotation around the centre, sampled at the faces
+  float omega = 0.01f;
+  glm::vec2 centre = glm::vec2(size) / 2.0f;
+  std::vector<glm::vec2> velocityData(size.x * size.y);
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      velocityData[i + size.x * j] = {-omega * (j + 0.5f - centre.y),
+                                      omega * (i + 0.5f - centre.x)};
+    }
+  }
+
+  Texture input(*device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  input.CopyFrom(velocityData);
+
+  Velocity velocity(*device, size, false);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { velocity.CopyFrom(commandBuffer, input); });
+
+  particleCount.VelocitiesBind(velocity, valid);
+  particleCount.TransferFromGrid();
+  device->Handle().waitIdle();
+
+  // The affine velocities of a linear field are exact, so the particle to grid
+  // transfer gives back the rotation on every face with particles around it
+  device->Execute([&](vk::CommandBuffer commandBuffer) { velocity.Clear(commandBuffer); });
+  particleCount.TransferToGrid();
+  device->Handle().waitIdle();
+
+  Texture output(*device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { output.CopyFrom(commandBuffer, velocity); });
+  std::vector<glm::vec2> outputData(size.x * size.y);
+  output.CopyTo(outputData);
+
+  std::vector<glm::ivec2> validData(size.x * size.y);
+  CopyTo(valid, validData);
+
+  int validCount = 0;
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      std::size_t index = i + size.x * j;
+      if (validData[index].x)
+      {
+        EXPECT_NEAR(velocityData[index].x, outputData[index].x, 1e-5f)
+            << "Mismatch at " << i << "," << j;
+        validCount++;
+      }
+      if (validData[index].y)
+      {
+        EXPECT_NEAR(velocityData[index].y, outputData[index].y, 1e-5f)
+            << "Mismatch at " << i << "," << j;
+        validCount++;
+      }
+    }
+  }
+
+  EXPECT_GT(validCount, size.x * size.y);
+}
+
+void ToGridTest(ParticleToGridMode toGridMode,
+                ParticleCellOrder cellOrder = ParticleCellOrder::RowMajor)
 {
   glm::ivec2 size(50);
 
@@ -610,7 +1206,12 @@ TEST(ParticleTests, ToGrid)
                               particles,
                               Velocity::InterpolationMode::Cubic,
                               {(int)sim.particles.size()},
-                              alpha);
+                              alpha,
+                              DefaultParticleSize(),
+                              ParticleLayout::Interleaved,
+                              toGridMode,
+                              ParticleTransfer::PicFlip,
+                              cellOrder);
 
   particleCount.Scan();
   device->Handle().waitIdle();
@@ -629,3 +1230,168 @@ TEST(ParticleTests, ToGrid)
 
   CheckVelocity(*device, size, velocity, sim, 1e-5f);
 }
+
+TEST(ParticleTests, ToGrid)
+{
+  ToGridTest(ParticleToGridMode::Gather);
+}
+
+TEST(ParticleTests, ToGrid_Scatter)
+{
+  ToGridTest(ParticleToGridMode::Scatter);
+}
+
+TEST(ParticleTests, ToGrid_Morton)
+{
+  ToGridTest(ParticleToGridMode::Gather, ParticleCellOrder::Morton);
+  ToGridTest(ParticleToGridMode::Scatter, ParticleCellOrder::Morton);
+}
+
+TEST(ParticleTests, ToGrid_ScatterDeterministic)
+{
+  glm::ivec2 size(20);
+
+  Buffer<Particle> particles(*device, 8 * size.x * size.y, VMA_MEMORY_USAGE_CPU_ONLY);
+  ParticleCount particleCount(*device,
+                              size,
+                              particles,
+                              Velocity::InterpolationMode::Cubic,
+                              {0},
+                              1.0f,
+                              DefaultParticleSize(),
+                              ParticleLayout::Interleaved,
+                              ParticleToGridMode::Scatter);
+
+  // The scatter accumulation order depends on the GPU scheduling
+  EXPECT_THROW(particleCount.SetDeterministic(true), std::runtime_error);
+  EXPECT_NO_THROW(particleCount.SetDeterministic(false));
+}
+
+uint64_t ToGridTime(const glm::ivec2& size,
+                    ParticleToGridMode toGridMode,
+                    ParticleCellOrder cellOrder = ParticleCellOrder::RowMajor)
+{
+  GenericBuffer particles(*device,
+                          vk::BufferUsageFlagBits::eStorageBuffer,
+                          VMA_MEMORY_USAGE_GPU_ONLY,
+                          8 * size.x * size.y * sizeof(Particle));
+  ParticleCount particleCount(*device,
+                              size,
+                              particles,
+                              Velocity::InterpolationMode::Cubic,
+                              {0},
+                              1.0f,
+                              DefaultParticleSize(),
+                              ParticleLayout::Interleaved,
+                              toGridMode,
+                              ParticleTransfer::PicFlip,
+                              cellOrder);
+
+  IntRectangle rect(*device, glm::vec2(size));
+  rect.Colour = glm::ivec4(4);
+
+  particleCount.Record({rect}).Submit();
+  particleCount.Scan();
+
+  Velocity velocity(*device, size);
+  Buffer<glm::ivec2> valid(*device, size.x * size.y);
+  particleCount.VelocitiesBind(velocity, valid);
+
+  // Warm up, then time a few transfers
+  particleCount.TransferToGrid();
+  device->Handle().waitIdle();
+
+  Timer timer(*device);
+  timer.Start();
+  for (int i = 0; i < 10; i++)
+  {
+    particleCount.TransferToGrid();
+  }
+  timer.Stop();
+  timer.Wait();
+
+  return timer.GetElapsedNs() / 10;
+}
+
+// Benchmark, only prints the timings. Run with --gtest_also_run_disabled_tests
+TEST(ParticleTests, DISABLED_ToGrid_Benchmark)
+{
+  auto properties = device->GetPhysicalDevice().getProperties();
+  if (!properties.limits.timestampComputeAndGraphics)
+  {
+    return;
+  }
+
+  glm::ivec2 size(512);
+
+  auto gatherTime = ToGridTime(size, ParticleToGridMode::Gather);
+  auto scatterTime = ToGridTime(size, ParticleToGridMode::Scatter);
+
+  std::cout << "Particle to grid " << size.x << "x" << size.y << " gather: " << gatherTime
+            << "ns, scatter: " << scatterTime << "ns" << std::endl;
+}
+
+uint64_t PhiTime(const glm::ivec2& size, ParticleCellOrder cellOrder)
+{
+  GenericBuffer particles(*device,
+                          vk::BufferUsageFlagBits::eStorageBuffer,
+                          VMA_MEMORY_USAGE_GPU_ONLY,
+                          8 * size.x * size.y * sizeof(Particle));
+  ParticleCount particleCount(*device,
+                              size,
+                              particles,
+                              Velocity::InterpolationMode::Cubic,
+                              {0},
+                              1.0f,
+                              DefaultParticleSize(),
+                              ParticleLayout::Interleaved,
+                              ParticleToGridMode::Gather,
+                              ParticleTransfer::PicFlip,
+                              cellOrder);
+
+  IntRectangle rect(*device, glm::vec2(size));
+  rect.Colour = glm::ivec4(4);
+
+  particleCount.Record({rect}).Submit();
+  particleCount.Scan();
+
+  LevelSet phi(*device, size);
+  particleCount.LevelSetBind(phi);
+
+  // Warm up, then time a few level set computations
+  particleCount.Phi();
+  device->Handle().waitIdle();
+
+  Timer timer(*device);
+  timer.Start();
+  for (int i = 0; i < 10; i++)
+  {
+    particleCount.Phi();
+  }
+  timer.Stop();
+  timer.Wait();
+
+  return timer.GetElapsedNs() / 10;
+}
+
+// Benchmark, only prints the timings. Run with --gtest_also_run_disabled_tests
+TEST(ParticleTests, DISABLED_CellOrder_Benchmark)
+{
+  auto properties = device->GetPhysicalDevice().getProperties();
+  if (!properties.limits.timestampComputeAndGraphics)
+  {
+    return;
+  }
+
+  glm::ivec2 size(512);
+
+  auto rowMajorToGrid = ToGridTime(size, ParticleToGridMode::Gather);
+  auto mortonToGrid = ToGridTime(size, ParticleToGridMode::Gather, ParticleCellOrder::Morton);
+  auto rowMajorPhi = PhiTime(size, ParticleCellOrder::RowMajor);
+  auto mortonPhi = PhiTime(size, ParticleCellOrder::Morton);
+
+  std::cout << "Particle to grid " << size.x << "x" << size.y << " row major: " << rowMajorToGrid
+            << "ns, morton: " << mortonToGrid << "ns" << std::endl;
+  std::cout << "Particle phi " << size.x << "x" << size.y << " row major: " << rowMajorPhi
+            << "ns, morton: " << mortonPhi << "ns" << std::endl;
+}
@@ -194,6 +194,7 @@ TEST(PressureTest, Project_Simple)
   Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
 
   pressure.ApplyPressure();
+  velocity.Resolve();
   device->Handle().waitIdle();
 
   CheckVelocity(*device, size, velocity, sim);
@@ -232,6 +233,7 @@ TEST(PressureTest, Project_Complex)
   Pressure pressure(*device, 0.01f, size, data, velocity, solidPhi, liquidPhi, valid);
 
   pressure.ApplyPressure();
+  velocity.Resolve();
   device->Handle().waitIdle();
 
   CheckVelocity(*device, size, velocity, sim);
@@ -744,6 +744,7 @@ TEST(RigidbodyTests, VelocityConstrain)
   rigidBody.SetVelocities(solid_velocity * glm::vec2(size.x), 0.0f);
   rigidBody.BindVelocityConstrain(velocity);
   rigidBody.VelocityConstrain();
+  velocity.Resolve();
 
   device->Handle().waitIdle();
 
@@ -804,6 +805,7 @@ TEST(RigidbodyTests, RotationConstrain)
   rigidBody.SetVelocities(glm::vec2(0.0f, 0.0f), w);
   rigidBody.BindVelocityConstrain(velocity);
   rigidBody.VelocityConstrain();
+  velocity.Resolve();
 
   device->Handle().waitIdle();
 
@@ -5,6 +5,7 @@
 
 #include <Vortex2D/Engine/Boundaries.h>
 #include <Vortex2D/Engine/Cfl.h>
+#include <Vortex2D/Engine/Checkpoint.h>
 #include <Vortex2D/Engine/Density.h>
 #include <Vortex2D/Engine/Rigidbody.h>
 #include <Vortex2D/Engine/World.h>
@@ -12,7 +13,11 @@
 #include "VariationalHelpers.h"
 #include "Verify.h"
 
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <random>
 
@@ -202,6 +207,556 @@ TEST(WorldTests, Velocity)
   CheckVelocity(*device, size, world.GetVelocity(), velocityData);
 }
 
+TEST(WorldTests, SharedResources)
+{
+  float dt = 0.01f;
+  glm::vec2 size(256.0f, 256.0f);
+
+  Renderer::ResourcePool pool;
+
+  Fluid::SmokeWorld world1(*device, size, dt, Fluid::Velocity::InterpolationMode::Cubic, &pool);
+  auto poolSize = pool.Size();
+  Fluid::SmokeWorld world2(*device, size, dt, Fluid::Velocity::InterpolationMode::Cubic, &pool);
+  EXPECT_EQ(poolSize, pool.Size());
+
+  Renderer::Clear fluidClear({-1.0f, 0.0f, 0.0f, 0.0f});
+  world1.RecordLiquidPhi({fluidClear}).Submit();
+  world2.RecordLiquidPhi({fluidClear}).Submit();
+
+  Renderer::Rectangle velocity1(*device, size);
+  velocity1.Colour = {-10.0f, -10.0f, 0.0f, 0.0f};
+
+  Renderer::Rectangle velocity2(*device, size);
+  velocity2.Colour = {10.0f, 10.0f, 0.0f, 0.0f};
+
+  world1.RecordVelocity({velocity1}, Fluid::VelocityOp::Set).Submit();
+  world2.RecordVelocity({velocity2}, Fluid::VelocityOp::Set).Submit();
+
+  auto params = Fluid::IterativeParams(1e-5f);
+  world1.Step(params);
+  device->Handle().waitIdle();
+  world2.Step(params);
+  device->Handle().waitIdle();
+
+  float value = 10.0f / size.x;
+  std::vector<glm::vec2> velocityData1(size.x * size.y, {-value, -value});
+  std::vector<glm::vec2> velocityData2(size.x * size.y, {value, value});
+
+  CheckVelocity(*device, size, world1.GetVelocity(), velocityData1);
+  CheckVelocity(*device, size, world2.GetVelocity(), velocityData2);
+}
+
+TEST(WorldTests, Checkpoint)
+{
+  float dt = 0.01f;
+  glm::ivec2 size(128, 128);
+
+  Fluid::SmokeWorld world1(*device, size, dt, Fluid::Velocity::InterpolationMode::Linear);
+  Fluid::Density density1(*device, size, vk::Format::eR8G8B8A8Unorm);
+  world1.FieldBind(density1);
+
+  Renderer::Clear fluidClear({-1.0f, 0.0f, 0.0f, 0.0f});
+  world1.RecordLiquidPhi({fluidClear}).Submit();
+
+  Renderer::Rectangle source(*device, {20.0f, 20.0f});
+  source.Position = {50.0f, 50.0f};
+  source.Colour = {1.0f, 0.5f, 0.0f, 1.0f};
+  density1.Record({source}).Submit();
+
+  Renderer::Rectangle velocity(*device, {40.0f, 40.0f});
+  velocity.Position = {40.0f, 40.0f};
+  velocity.Colour = {5.0f, -3.0f, 0.0f, 0.0f};
+  world1.RecordVelocity({velocity}, Fluid::VelocityOp::Set).Submit();
+
+  auto params = Fluid::IterativeParams(1e-5f);
+  world1.Step(params);
+
+  std::string filename = testing::TempDir() + "vortex2d_checkpoint.bin";
+  world1.SaveCheckpoint(filename, true);
+
+  Fluid::SmokeWorld world2(*device, size, dt, Fluid::Velocity::InterpolationMode::Linear);
+  Fluid::Density density2(*device, size, vk::Format::eR8G8B8A8Unorm);
+  world2.FieldBind(density2);
+  world2.LoadCheckpoint(filename);
+
+  Renderer::Texture localVelocity(
+      *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  Renderer::Texture localDensity(
+      *device, size.x, size.y, vk::Format::eR8G8B8A8Unorm, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    localVelocity.CopyFrom(commandBuffer, world1.GetVelocity());
+    localDensity.CopyFrom(commandBuffer, density1);
+  });
+
+  std::vector<glm::vec2> velocityData(size.x * size.y);
+  localVelocity.CopyTo(velocityData);
+  std::vector<uint32_t> densityData(size.x * size.y);
+  localDensity.CopyTo(densityData);
+
+  CheckVelocity(*device, size, world2.GetVelocity(), velocityData, 0.0f);
+
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    localDensity.CopyFrom(commandBuffer, density2);
+  });
+  CheckTexture(densityData, localDensity);
+
+  // Extra chunks are ignored, missing chunks throw
+  Fluid::SmokeWorld world3(*device, size, dt, Fluid::Velocity::InterpolationMode::Linear);
+  EXPECT_NO_THROW(world3.LoadCheckpoint(filename));
+
+  Fluid::SmokeWorld world4(*device, size, dt, Fluid::Velocity::InterpolationMode::Linear);
+  Fluid::Density density4(*device, size, vk::Format::eR8G8B8A8Unorm);
+  Fluid::Density density5(*device, size, vk::Format::eR8G8B8A8Unorm);
+  world4.FieldBind(density4);
+  world4.FieldBind(density5);
+  EXPECT_THROW(world4.LoadCheckpoint(filename), std::runtime_error);
+
+  std::remove(filename.c_str());
+}
+
+TEST(WorldTests, CheckpointHostData)
+{
+  std::string filename1 = testing::TempDir() + "vortex2d_checkpoint1.bin";
+  std::string filename2 = testing::TempDir() + "vortex2d_checkpoint2.bin";
+
+  Fluid::Checkpoint writer1(*device);
+  writer1.SetHostData("extra", {1, 2, 3});
+  writer1.Write(filename1);
+
+  Fluid::Checkpoint writer2(*device);
+  writer2.Write(filename2);
+
+  // Host chunks of a previous read are not kept
+  Fluid::Checkpoint reader(*device);
+  reader.Read(filename1);
+  EXPECT_EQ(3u, reader.GetSize("extra"));
+  reader.Read(filename2);
+  EXPECT_EQ(0u, reader.GetSize("extra"));
+
+  std::remove(filename1.c_str());
+  std::remove(filename2.c_str());
+}
+
+TEST(WorldTests, StaticSolidPhi)
+{
+  float dt = 0.01f;
+  glm::ivec2 size(50);
+
+  Fluid::SmokeWorld world(*device, size, dt, Fluid::Velocity::InterpolationMode::Linear);
+  Renderer::Texture outTexture(
+      *device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  auto solidPhiAt = [&](int i, int j) {
+    device->Handle().waitIdle();
+    device->Execute([&](vk::CommandBuffer commandBuffer) {
+      outTexture.CopyFrom(commandBuffer, world.GetSolidPhi());
+    });
+
+    std::vector<float> data(size.x * size.y);
+    outTexture.CopyTo(data);
+    return data[i + j * size.x];
+  };
+
+  auto params = Fluid::FixedParams(12);
+  world.Step(params);
+  EXPECT_GT(solidPhiAt(25, 25), 0.0f);
+
+  // Drawing the static solid level set after a step updates the solid level set
+  Fluid::Rectangle obstacle(*device, {10.0f, 10.0f});
+  obstacle.Position = {20.0f, 20.0f};
+  world.RecordStaticSolidPhi({obstacle}).Submit().Wait();
+
+  world.Step(params);
+  EXPECT_LT(solidPhiAt(25, 25), 0.0f);
+
+  // Nothing changed, the solid level set is kept
+  world.Step(params);
+  EXPECT_LT(solidPhiAt(25, 25), 0.0f);
+  EXPECT_GT(solidPhiAt(5, 5), 0.0f);
+}
+
+TEST(WorldTests, StaticSolidPhi_RigidbodyMove)
+{
+  float dt = 0.01f;
+  glm::ivec2 size(50);
+
+  Fluid::SmokeWorld world(*device, size, dt, Fluid::Velocity::InterpolationMode::Linear);
+  Renderer::Texture outTexture(
+      *device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  auto solidPhiAt = [&](int i, int j) {
+    device->Handle().waitIdle();
+    device->Execute([&](vk::CommandBuffer commandBuffer) {
+      outTexture.CopyFrom(commandBuffer, world.GetSolidPhi());
+    });
+
+    std::vector<float> data(size.x * size.y);
+    outTexture.CopyTo(data);
+    return data[i + j * size.x];
+  };
+
+  Fluid::Rectangle obstacle(*device, {10.0f, 10.0f});
+  obstacle.Position = {5.0f, 5.0f};
+  world.RecordStaticSolidPhi({obstacle}).Submit().Wait();
+
+  Fluid::Rectangle rectangle(*device, {6.0f, 6.0f});
+  Fluid::RigidBody rigidbody(*device, size, rectangle, Fluid::RigidBody::Type::eStatic);
+  rigidbody.Position = {35.0f, 5.0f};
+  world.AddRigidbody(rigidbody);
+
+  // The cell is further than the obstacle's extent, only the reinitialised
+  // static level set gives its distance
+  auto params = Fluid::FixedParams(12);
+  world.Step(params);
+  float distance = glm::length(glm::vec2(10.5f));
+  EXPECT_NEAR(solidPhiAt(25, 25), distance, 1.5f);
+  EXPECT_LT(solidPhiAt(37, 7), 0.0f);
+
+  // Moving the rigidbody keeps the reinitialised static level set
+  rigidbody.Position = {38.0f, 5.0f};
+  world.Step(params);
+  EXPECT_NEAR(solidPhiAt(25, 25), distance, 1.5f);
+  EXPECT_LT(solidPhiAt(10, 10), 0.0f);
+  EXPECT_LT(solidPhiAt(41, 7), 0.0f);
+  EXPECT_GT(solidPhiAt(36, 7), 0.0f);
+}
+
+std::vector<uint32_t> DeterministicWaterRun(int steps)
+{
+  float dt = 0.01f;
+  glm::ivec2 size(64, 64);
+
+  Fluid::WaterWorld world(*device, size, dt, 2, Fluid::Velocity::InterpolationMode::Linear);
+  world.SetDeterministic(true, 42);
+
+  Renderer::IntRectangle fluidArea(*device, {40.0f, 30.0f});
+  fluidArea.Position = {12.0f, 10.0f};
+  fluidArea.Colour = glm::vec4(4);
+  world.RecordParticleCount({fluidArea}).Submit().Wait();
+
+  Fluid::Rectangle obstacle(*device, {10.0f, 10.0f});
+  obstacle.Position = {30.0f, 45.0f};
+  world.RecordStaticSolidPhi({Fluid::BoundariesClear, obstacle}).Submit().Wait();
+
+  Renderer::Rectangle gravity(*device, size);
+  gravity.Colour = glm::vec4(0.0f, -dt * 9.8f, 0.0f, 0.0f);
+  auto gravityRender = world.RecordVelocity({gravity}, Fluid::VelocityOp::Add);
+
+  auto params = Fluid::FixedParams(12);
+  for (int i = 0; i < steps; i++)
+  {
+    world.SubmitVelocity(gravityRender);
+    world.Step(params);
+  }
+
+  return world.GetStepHashes();
+}
+
+TEST(WorldTests, Deterministic)
+{
+  auto hashes1 = DeterministicWaterRun(10);
+  auto hashes2 = DeterministicWaterRun(10);
+
+  ASSERT_EQ(10u, hashes1.size());
+  EXPECT_EQ(hashes1, hashes2);
+  EXPECT_NE(hashes1.front(), hashes1.back());
+}
+
+TEST(WorldTests, NarrowBandDepth)
+{
+  float dt = 0.01f;
+  glm::ivec2 size(64, 64);
+
+  Fluid::WaterWorld world(*device, size, dt, 2, Fluid::Velocity::InterpolationMode::Linear);
+
+  Renderer::IntRectangle fluidArea(*device, {44.0f, 44.0f});
+  fluidArea.Position = {10.0f, 10.0f};
+  fluidArea.Colour = glm::vec4(4);
+  world.RecordParticleCount({fluidArea}).Submit().Wait();
+
+  EXPECT_THROW(world.SetNarrowBand(-1.0f), std::runtime_error);
+
+  // Wider than the default reinitialised band of the liquid level set
+  world.SetNarrowBand(14.0f);
+
+  auto params = Fluid::FixedParams(12);
+  world.Step(params);
+  device->Queue().waitIdle();
+
+  Renderer::Texture output(
+      *device, size.x, size.y, vk::Format::eR32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    output.CopyFrom(commandBuffer, world.GetLiquidPhi());
+  });
+
+  std::vector<float> phi(size.x * size.y);
+  output.CopyTo(phi);
+
+  // The level set must go deeper than the band for the band to have an interior
+  EXPECT_LT(*std::min_element(phi.begin(), phi.end()), -14.0f);
+}
+
+std::vector<glm::vec2> HalfVelocityRun(Fluid::Velocity::Precision precision)
+{
+  float dt = 0.01f;
+  glm::ivec2 size(64, 64);
+
+  Fluid::SmokeWorld world(*device,
+                          size,
+                          dt,
+                          Fluid::Velocity::InterpolationMode::Linear,
+                          nullptr,
+                          precision);
+
+  Renderer::Clear fluidClear({-1.0f, 0.0f, 0.0f, 0.0f});
+  world.RecordLiquidPhi({fluidClear}).Submit();
+
+  Fluid::Rectangle obstacle(*device, {10.0f, 10.0f});
+  obstacle.Position = {40.0f, 40.0f};
+  world.RecordStaticSolidPhi({Fluid::BoundariesClear, obstacle}).Submit().Wait();
+
+  Renderer::Rectangle velocity(*device, {20.0f, 20.0f});
+  velocity.Position = {20.0f, 20.0f};
+  velocity.Colour = {5.0f, 3.0f, 0.0f, 0.0f};
+  world.RecordVelocity({velocity}, Fluid::VelocityOp::Set).Submit();
+
+  auto params = Fluid::IterativeParams(1e-5f);
+  for (int i = 0; i < 3; i++)
+  {
+    world.Step(params);
+  }
+
+  std::vector<glm::vec2> velocityData(size.x * size.y);
+  auto& worldVelocity = world.GetVelocity();
+  Renderer::Texture localVelocity(
+      *device, size.x, size.y, worldVelocity.GetFormat(), VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    localVelocity.CopyFrom(commandBuffer, worldVelocity);
+  });
+
+  if (precision == Fluid::Velocity::Precision::Half)
+  {
+    std::vector<uint32_t> halfData(size.x * size.y);
+    localVelocity.CopyTo(halfData);
+    for (std::size_t i = 0; i < halfData.size(); i++)
+    {
+      velocityData[i] = glm::unpackHalf2x16(halfData[i]);
+    }
+  }
+  else
+  {
+    localVelocity.CopyTo(velocityData);
+  }
+
+  return velocityData;
+}
+
+TEST(WorldTests, HalfVelocity)
+{
+  auto floatVelocity = HalfVelocityRun(Fluid::Velocity::Precision::Float);
+  auto halfVelocity = HalfVelocityRun(Fluid::Velocity::Precision::Half);
+
+  ASSERT_EQ(floatVelocity.size(), halfVelocity.size());
+
+  // The stored velocities are relative to the width, compare them relative to
+  // the largest one
+  float maxValue = 0.0f;
+  for (auto& value : floatVelocity)
+  {
+    maxValue = std::max(maxValue, std::max(std::abs(value.x), std::abs(value.y)));
+  }
+  ASSERT_GT(maxValue, 0.0f);
+
+  float error = 1e-2f * maxValue;
+  for (std::size_t i = 0; i < floatVelocity.size(); i++)
+  {
+    EXPECT_NEAR(floatVelocity[i].x, halfVelocity[i].x, error) << "at " << i;
+    EXPECT_NEAR(floatVelocity[i].y, halfVelocity[i].y, error) << "at " << i;
+  }
+}
+
+TEST(WorldTests, Forces)
+{
+  float dt = 0.01f;
+  glm::ivec2 size(50);
+
+  Fluid::Velocity velocity(*device, size);
+  Fluid::Density density(*device, size, vk::Format::eR8G8B8A8Unorm);
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    velocity.Clear(commandBuffer);
+    density.Clear(commandBuffer, std::array<float, 4>{1.0f, 1.0f, 1.0f, 1.0f});
+  });
+
+  Fluid::Forces forces(*device, size, dt, velocity);
+
+  // Nothing enabled
+  forces.Apply();
+  device->Queue().waitIdle();
+  CheckVelocity(*device, size, velocity, std::vector<glm::vec2>(size.x * size.y));
+
+  // Same velocity as drawing the acceleration over one time step
+  Fluid::SmokeWorld world(*device, size, dt, Fluid::Velocity::InterpolationMode::Linear);
+  Renderer::Rectangle gravityRect(*device, size);
+  gravityRect.Colour = {0.0f, -10.0f * dt, 0.0f, 0.0f};
+  world.RecordVelocity({gravityRect}, Fluid::VelocityOp::Set).Submit();
+  device->Queue().waitIdle();
+
+  Renderer::Texture output(
+      *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute([&](vk::CommandBuffer commandBuffer) {
+    output.CopyFrom(commandBuffer, world.GetVelocity());
+  });
+  std::vector<glm::vec2> drawnVelocity(size.x * size.y);
+  output.CopyTo(drawnVelocity);
+
+  forces.SetGravity({0.0f, -10.0f});
+  forces.Apply();
+  device->Queue().waitIdle();
+  CheckVelocity(*device, size, velocity, drawnVelocity);
+
+  glm::vec2 expected(0.0f, -10.0f * dt / size.x);
+  CheckVelocity(*device, size, velocity, std::vector<glm::vec2>(size.x * size.y, expected));
+
+  // A uniform velocity has no curl, so the confinement doesn't change it
+  forces.SetGravity({0.0f, 0.0f});
+  forces.SetDrag(2.0f);
+  forces.SetVorticityConfinement(1.0f);
+  forces.BuoyancyBind(density, {0.0f, 4.0f}, 0.5f);
+  forces.Apply();
+  velocity.Resolve();
+  device->Queue().waitIdle();
+  expected /= 1.0f + 2.0f * dt;
+  expected += glm::vec2(0.0f, 4.0f * 0.5f * dt / size.x);
+  CheckVelocity(
+      *device, size, velocity, std::vector<glm::vec2>(size.x * size.y, expected), 1e-6f);
+}
+
+// Same stencil as VorticityConfinement.comp, velocities outside the grid are
+// the ones on the border. Cells where the gradient of the curl is too close to
+// the kernel's threshold are marked as undecided.
+void VorticityConfinementReference(const glm::ivec2& size,
+                                   const std::vector<glm::vec2>& input,
+                                   float dt,
+                                   float strength,
+                                   std::vector<glm::vec2>& output,
+                                   std::vector<bool>& undecided)
+{
+  auto velocity = [&](int i, int j) {
+    i = glm::clamp(i, 0, size.x - 1);
+    j = glm::clamp(j, 0, size.y - 1);
+    return input[i + j * size.x];
+  };
+
+  auto centre = [&](int i, int j) {
+    return 0.5f * glm::vec2(velocity(i, j).x + velocity(i + 1, j).x,
+                            velocity(i, j).y + velocity(i, j + 1).y);
+  };
+
+  auto curl = [&](int i, int j) {
+    return 0.5f * (centre(i + 1, j).y - centre(i - 1, j).y - centre(i, j + 1).x +
+                   centre(i, j - 1).x);
+  };
+
+  auto force = [&](int i, int j, bool& ambiguous) {
+    glm::vec2 gradient = 0.5f * glm::vec2(std::abs(curl(i + 1, j)) - std::abs(curl(i - 1, j)),
+                                          std::abs(curl(i, j + 1)) - std::abs(curl(i, j - 1)));
+    float gradientLength = glm::length(gradient);
+    ambiguous = ambiguous || (gradientLength > 1e-6f && gradientLength < 1e-4f);
+    if (gradientLength > 1e-5f)
+    {
+      glm::vec2 normal = gradient / gradientLength;
+      return strength * curl(i, j) * glm::vec2(normal.y, -normal.x);
+    }
+
+    return glm::vec2(0.0f);
+  };
+
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      bool ambiguous = false;
+      glm::vec2 cellForce = force(i, j, ambiguous);
+      glm::vec2 faceForce = 0.5f * glm::vec2(cellForce.x + force(i - 1, j, ambiguous).x,
+                                             cellForce.y + force(i, j - 1, ambiguous).y);
+
+      std::size_t index = i + j * size.x;
+      output[index] = velocity(i, j) + dt * faceForce;
+      undecided[index] = ambiguous;
+    }
+  }
+}
+
+TEST(WorldTests, VorticityConfinement)
+{
+  float dt = 0.01f;
+  float strength = 2.0f;
+  glm::ivec2 size(50);
+
+  // Gaussian vortex, off the centre of the cells so the curl isn't symmetric
+  glm::vec2 vortexCentre(23.3f, 26.7f);
+  auto vortex = [&](const glm::vec2& pos) {
+    glm::vec2 r = pos - vortexCentre;
+    return 0.01f * std::exp(-glm::dot(r, r) / 64.0f) * glm::vec2(-r.y, r.x);
+  };
+
+  std::vector<glm::vec2> velocityData(size.x * size.y);
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      std::size_t index = i + j * size.x;
+      velocityData[index].x = vortex(glm::vec2(i, j + 0.5f)).x;
+      velocityData[index].y = vortex(glm::vec2(i + 0.5f, j)).y;
+    }
+  }
+
+  Renderer::Texture input(
+      *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  input.CopyFrom(velocityData);
+
+  Fluid::Velocity velocity(*device, size);
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { velocity.CopyFrom(commandBuffer, input); });
+
+  Fluid::Forces forces(*device, size, dt, velocity);
+  forces.SetVorticityConfinement(strength);
+  forces.Apply();
+  velocity.Resolve();
+  device->Queue().waitIdle();
+
+  Renderer::Texture output(
+      *device, size.x, size.y, vk::Format::eR32G32Sfloat, VMA_MEMORY_USAGE_CPU_ONLY);
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { output.CopyFrom(commandBuffer, velocity); });
+  std::vector<glm::vec2> outputData(size.x * size.y);
+  output.CopyTo(outputData);
+
+  std::vector<glm::vec2> expected(size.x * size.y);
+  std::vector<bool> undecided(size.x * size.y);
+  VorticityConfinementReference(size, velocityData, dt, strength, expected, undecided);
+
+  float maxChange = 0.0f;
+  for (int i = 0; i < size.x; i++)
+  {
+    for (int j = 0; j < size.y; j++)
+    {
+      std::size_t index = i + j * size.x;
+      maxChange = std::max(maxChange, glm::length(outputData[index] - velocityData[index]));
+      if (!undecided[index])
+      {
+        EXPECT_NEAR(expected[index].x, outputData[index].x, 1e-6f)
+            << "Mismatch at " << i << "," << j;
+        EXPECT_NEAR(expected[index].y, outputData[index].y, 1e-6f)
+            << "Mismatch at " << i << "," << j;
+      }
+    }
+  }
+
+  // The confinement spins up the vortex
+  EXPECT_GT(maxChange, 1e-5f);
+}
+
 TEST(CflTets, Max)
 {
   glm::ivec2 size(50);
@@ -9,6 +9,8 @@
 #include <Vortex2D/Renderer/CommandBuffer.h>
 #include <Vortex2D/Renderer/DescriptorSet.h>
 #include <Vortex2D/Renderer/Pipeline.h>
+#include <Vortex2D/Renderer/Readback.h>
+#include <Vortex2D/Renderer/ResourcePool.h>
 #include <Vortex2D/Renderer/Timer.h>
 #include <Vortex2D/Renderer/Work.h>
 #include <Vortex2D/SPIRV/Reflection.h>
@@ -403,6 +405,45 @@ TEST(ComputeTests, Timer)
   std::cout << "Elapsed time: " << time << std::endl;
 }
 
+TEST(ComputeTests, Readback)
+{
+  Buffer<int> buffer(*device);
+  Buffer<int> inBuffer(*device, 1, VMA_MEMORY_USAGE_CPU_ONLY);
+
+  Readback readback(*device, buffer, 2);
+
+  int value = -1;
+  ASSERT_FALSE(readback.Get(value));
+  ASSERT_EQ(-1, value);
+
+  for (int i = 0; i < 5; i++)
+  {
+    CopyFrom(inBuffer, i);
+    device->Execute(
+        [&](vk::CommandBuffer commandBuffer) { buffer.CopyFrom(commandBuffer, inBuffer); });
+
+    readback.Submit();
+  }
+
+  readback.Wait();
+  ASSERT_TRUE(readback.Get(value));
+  ASSERT_EQ(4, value);
+
+  // Submit more copies than host buffers without waiting on the device
+  CopyFrom(inBuffer, 5);
+  device->Execute(
+      [&](vk::CommandBuffer commandBuffer) { buffer.CopyFrom(commandBuffer, inBuffer); });
+
+  for (int i = 0; i < 5; i++)
+  {
+    readback.Submit();
+  }
+
+  readback.Wait();
+  ASSERT_TRUE(readback.Get(value));
+  ASSERT_EQ(5, value);
+}
+
 TEST(ComputeTests, Reflection)
 {
   Reflection spirv1(Stencil_comp);
@@ -456,3 +497,39 @@ TEST(ComputeTests, Cache)
   EXPECT_EQ(pipelineLayout2, device->GetLayoutManager().GetPipelineLayout(layout2));
   EXPECT_EQ(pipeline2, device->GetPipelineCache().CreateComputePipeline(shader2, pipelineLayout2));
 }
+
+TEST(ComputeTests, DescriptorPoolGrowth)
+{
+  Reflection reflection(Buffer_comp);
+  PipelineLayout layout = {{reflection}};
+
+  std::vector<DescriptorSet> descriptorSets;
+  for (int i = 0; i < 600; i++)
+  {
+    descriptorSets.push_back(device->GetLayoutManager().MakeDescriptorSet(layout));
+  }
+
+  EXPECT_GT(device->GetLayoutManager().GetDescriptorPoolCount(), 1u);
+}
+
+TEST(ComputeTests, ResourcePool)
+{
+  ResourcePool pool;
+  glm::ivec2 size(16);
+
+  auto texture = AcquireTexture(&pool, "Texture", *device, size, vk::Format::eR32Sfloat);
+  EXPECT_EQ(texture, AcquireTexture(&pool, "Texture", *device, size, vk::Format::eR32Sfloat));
+
+  // The format is part of the key
+  auto otherFormat = AcquireTexture(&pool, "Texture", *device, size, vk::Format::eR32G32Sfloat);
+  EXPECT_NE(texture, otherFormat);
+  EXPECT_EQ(vk::Format::eR32G32Sfloat, otherFormat->GetFormat());
+
+  auto buffer = Acquire<Buffer<float>>(&pool, "Buffer", *device, size, size.x * size.y);
+  EXPECT_EQ(buffer, Acquire<Buffer<float>>(&pool, "Buffer", *device, size, size.x * size.y));
+  EXPECT_EQ(3u, pool.Size());
+
+  // Without a pool, the resources aren't shared
+  EXPECT_NE(AcquireTexture(nullptr, "Texture", *device, size, vk::Format::eR32Sfloat),
+            AcquireTexture(nullptr, "Texture", *device, size, vk::Format::eR32Sfloat));
+}
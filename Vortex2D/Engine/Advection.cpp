@@ -8,89 +8,304 @@
 #include <Vortex2D/Engine/Density.h>
 #include <Vortex2D/Renderer/Pipeline.h>
 
+#include <algorithm>
+
 #include "vortex2d_generated_spirv.h"
 
 namespace Vortex2D
 {
 namespace Fluid
 {
+namespace
+{
+// Number of fields advected by one dispatch of Advect.comp
+const std::size_t MaxAdvectFields = 4;
+}  // namespace
+
 Advection::Advection(const Renderer::Device& device,
                      const glm::ivec2& size,
                      float dt,
                      Velocity& velocity,
-                     Velocity::InterpolationMode interpolationMode)
+                     Velocity::InterpolationMode interpolationMode,
+                     ParticleLayout particleLayout,
+                     ParticleTransfer particleTransfer)
     : mDevice(device)
     , mDt(dt)
     , mSize(size)
     , mVelocity(velocity)
+    , mMode(AdvectionMode::SemiLagrangian)
     , mVelocityAdvect(device,
                       size,
-                      SPIRV::AdvectVelocity_comp,
+                      VelocityShader(velocity.GetPrecision(),
+                                     SPIRV::AdvectVelocity_comp,
+                                     SPIRV::AdvectVelocityHalf_comp),
                       Renderer::SpecConst(Renderer::SpecConstValue(3, interpolationMode)))
-    , mVelocityAdvectBound(mVelocityAdvect.Bind({velocity, velocity.Output()}))
-    , mAdvect(device, size, SPIRV::Advect_comp)
+    , mVelocityMacCormack(device,
+                          size,
+                          VelocityShader(velocity.GetPrecision(),
+                                         SPIRV::AdvectVelocityMacCormack_comp,
+                                         SPIRV::AdvectVelocityMacCormackHalf_comp),
+                          Renderer::SpecConst(Renderer::SpecConstValue(3, interpolationMode)))
+    , mAdvect(device,
+              size,
+              VelocityShader(velocity.GetPrecision(), SPIRV::Advect_comp, SPIRV::AdvectHalf_comp))
+    , mMacCormack(device,
+                  size,
+                  VelocityShader(velocity.GetPrecision(),
+                                 SPIRV::AdvectMacCormack_comp,
+                                 SPIRV::AdvectMacCormackHalf_comp))
     , mAdvectParticles(device,
                        Renderer::ComputeSize::Default1D(),
-                       SPIRV::AdvectParticles_comp,
-                       Renderer::SpecConst(Renderer::SpecConstValue(3, interpolationMode)))
-    , mAdvectVelocityCmd(device, false)
-    , mAdvectCmd(device, false)
-    , mAdvectParticlesCmd(device, false)
-{
-  mAdvectVelocityCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Velocity advect", {{0.15f, 0.46f, 0.19f, 1.0f}}},
-                                      mDevice.Loader());
-    mVelocityAdvectBound.PushConstant(commandBuffer, dt);
-    mVelocityAdvectBound.Record(commandBuffer);
-    velocity.CopyBack(commandBuffer);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+                       VelocityShader(velocity.GetPrecision(),
+                                      SPIRV::AdvectParticles_comp,
+                                      SPIRV::AdvectParticlesHalf_comp),
+                       Renderer::SpecConst(
+                           Renderer::SpecConstValue(3, interpolationMode),
+                           Renderer::SpecConstValue(4, static_cast<int>(particleLayout)),
+                           Renderer::SpecConstValue(5, static_cast<int>(particleTransfer))))
+    , mParticles{}
+    , mDispatchParams(nullptr)
+    , mParticleCount(nullptr)
+    , mParticleCfl(0.0f)
+    , mParticleMaxSubSteps(1)
+{
+  // The velocity is advected from its front field into its back field
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    mVelocityAdvectBound[i] = mVelocityAdvect.Bind({velocity.Field(i), velocity.Field(1 - i)});
+
+    mAdvectVelocityCmd.emplace_back(device, false);
+    mAdvectCmd.emplace_back(device, false);
+  }
+
+  mAdvectParticlesCmd.emplace_back(device, false);
+  mAdvectParticlesCmd.emplace_back(device, false);
+
+  RecordVelocityAdvect();
+}
+
+void Advection::SetMode(AdvectionMode mode)
+{
+  mDevice.Queue().waitIdle();
+  mMode = mode;
+
+  RecordVelocityAdvect();
+  if (!mDensities.empty())
+  {
+    RecordAdvect();
+  }
+}
+
+void Advection::RecordVelocityAdvect()
+{
+  // The MacCormack correction reads the semi-Lagrangian advection from a
+  // temporary texture, created the first time it's used
+  bool macCormack = mMode == AdvectionMode::MacCormack;
+  if (macCormack && !mVelocityHat)
+  {
+    mVelocityHat =
+        std::make_unique<Renderer::Texture>(mDevice, mSize.x, mSize.y, mVelocity.GetFormat());
+    for (std::size_t i = 0; i < 2; i++)
+    {
+      mVelocityHatBound[i] = mVelocityAdvect.Bind({mVelocity.Field(i), *mVelocityHat});
+      mVelocityMacCormackBound[i] = mVelocityMacCormack.Bind(
+          {mVelocity.Field(i), *mVelocityHat, mVelocity.Field(1 - i)});
+    }
+  }
+
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    auto& back = mVelocity.Field(1 - i);
+
+    mAdvectVelocityCmd[i].Record([&, i, macCormack](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Velocity advect", {{0.15f, 0.46f, 0.19f, 1.0f}}},
+                                        mDevice.Loader());
+      if (macCormack)
+      {
+        mVelocityHatBound[i].PushConstant(commandBuffer, mDt);
+        mVelocityHatBound[i].Record(commandBuffer);
+        mVelocityHat->Barrier(commandBuffer,
+                              vk::ImageLayout::eGeneral,
+                              vk::AccessFlagBits::eShaderWrite,
+                              vk::ImageLayout::eGeneral,
+                              vk::AccessFlagBits::eShaderRead);
+        mVelocityMacCormackBound[i].PushConstant(commandBuffer, mDt);
+        mVelocityMacCormackBound[i].Record(commandBuffer);
+      }
+      else
+      {
+        mVelocityAdvectBound[i].PushConstant(commandBuffer, mDt);
+        mVelocityAdvectBound[i].Record(commandBuffer);
+      }
+
+      back.Barrier(commandBuffer,
+                   vk::ImageLayout::eGeneral,
+                   vk::AccessFlagBits::eShaderWrite,
+                   vk::ImageLayout::eGeneral,
+                   vk::AccessFlagBits::eShaderRead);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
 }
 
 void Advection::AdvectVelocity()
 {
-  mAdvectVelocityCmd.Submit();
+  mAdvectVelocityCmd[mVelocity.Front()].Submit();
+  mVelocity.Swap();
 }
 
 void Advection::AdvectBind(Density& density)
 {
-  mAdvectBound = mAdvect.Bind({mVelocity, density, density.mFieldBack});
-  mAdvectCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Density advect", {{0.86f, 0.14f, 0.52f, 1.0f}}},
-                                      mDevice.Loader());
-    mAdvectBound.PushConstant(commandBuffer, mDt);
-    mAdvectBound.Record(commandBuffer);
-    density.mFieldBack.Barrier(commandBuffer,
-                               vk::ImageLayout::eGeneral,
-                               vk::AccessFlagBits::eShaderWrite,
-                               vk::ImageLayout::eGeneral,
-                               vk::AccessFlagBits::eShaderRead);
-    density.CopyFrom(commandBuffer, density.mFieldBack);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  mDensities.push_back(&density);
+  RecordAdvect();
+}
+
+void Advection::RecordAdvect()
+{
+  // The MacCormack correction reads the semi-Lagrangian advection of each
+  // field from a temporary texture
+  bool macCormack = mMode == AdvectionMode::MacCormack;
+  if (macCormack)
+  {
+    for (std::size_t i = mFieldHats.size(); i < mDensities.size(); i++)
+    {
+      mFieldHats.push_back(std::make_unique<Renderer::Texture>(
+          mDevice, mSize.x, mSize.y, mDensities[i]->GetFormat()));
+    }
+  }
+
+  // Each dispatch advects a batch of fields, the unused bindings of the last
+  // one are bound to its first field. The fields are advected with the front
+  // field of the velocity.
+  for (std::size_t front = 0; front < 2; front++)
+  {
+    auto& advectBound = mAdvectBound[front];
+    auto& macCormackBound = mMacCormackBound[front];
+    advectBound.clear();
+    macCormackBound.clear();
+    for (std::size_t i = 0; i < mDensities.size(); i += MaxAdvectFields)
+    {
+      std::vector<Renderer::BindingInput> inputs = {mVelocity.Field(front)};
+      std::vector<Renderer::BindingInput> correctInputs = {mVelocity.Field(front)};
+      for (std::size_t j = 0; j < MaxAdvectFields; j++)
+      {
+        auto index = i + j < mDensities.size() ? i + j : i;
+        auto* field = mDensities[index];
+        if (macCormack)
+        {
+          inputs.push_back(*field);
+          inputs.push_back(*mFieldHats[index]);
+          correctInputs.push_back(*field);
+          correctInputs.push_back(*mFieldHats[index]);
+          correctInputs.push_back(field->mFieldBack);
+        }
+        else
+        {
+          inputs.push_back(*field);
+          inputs.push_back(field->mFieldBack);
+        }
+      }
+
+      advectBound.push_back(mAdvect.Bind(inputs));
+      if (macCormack)
+      {
+        macCormackBound.push_back(mMacCormack.Bind(correctInputs));
+      }
+    }
+
+    mAdvectCmd[front].Record([&, macCormack](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Density advect", {{0.86f, 0.14f, 0.52f, 1.0f}}},
+                                        mDevice.Loader());
+      for (std::size_t i = 0; i < advectBound.size(); i++)
+      {
+        auto count = std::min(MaxAdvectFields, mDensities.size() - i * MaxAdvectFields);
+        advectBound[i].PushConstant(commandBuffer, mDt, static_cast<int>(count));
+        advectBound[i].Record(commandBuffer);
+      }
+
+      if (macCormack)
+      {
+        for (std::size_t i = 0; i < mDensities.size(); i++)
+        {
+          mFieldHats[i]->Barrier(commandBuffer,
+                                 vk::ImageLayout::eGeneral,
+                                 vk::AccessFlagBits::eShaderWrite,
+                                 vk::ImageLayout::eGeneral,
+                                 vk::AccessFlagBits::eShaderRead);
+        }
+
+        for (std::size_t i = 0; i < macCormackBound.size(); i++)
+        {
+          auto count = std::min(MaxAdvectFields, mDensities.size() - i * MaxAdvectFields);
+          macCormackBound[i].PushConstant(commandBuffer, mDt, static_cast<int>(count));
+          macCormackBound[i].Record(commandBuffer);
+        }
+      }
+
+      for (auto* field : mDensities)
+      {
+        field->mFieldBack.Barrier(commandBuffer,
+                                  vk::ImageLayout::eGeneral,
+                                  vk::AccessFlagBits::eShaderWrite,
+                                  vk::ImageLayout::eGeneral,
+                                  vk::AccessFlagBits::eShaderRead);
+        field->CopyFrom(commandBuffer, field->mFieldBack);
+      }
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
 }
 
 void Advection::Advect()
 {
-  if (mAdvectCmd)
+  if (!mDensities.empty())
+  {
+    mAdvectCmd[mVelocity.Front()].Submit();
+  }
+}
+
+void Advection::AdvectParticleBind(
+    Renderer::GenericBuffer& particles,
+    Renderer::Texture& levelSet,
+    Renderer::IndirectBuffer<Renderer::DispatchParams>& dispatchParams)
+{
+  mParticles = {};
+  mParticleCount = nullptr;
+  AdvectParticleBind(0, particles, levelSet, dispatchParams);
+}
+
+void Advection::AdvectParticleBind(ParticleCount& particleCount, Renderer::Texture& levelSet)
+{
+  mParticleCount = &particleCount;
+  for (std::size_t i = 0; i < 2; i++)
   {
-    mAdvectCmd.Submit();
+    AdvectParticleBind(
+        i, particleCount.GetParticles(i), levelSet, particleCount.GetDispatchParams());
   }
 }
 
 void Advection::AdvectParticleBind(
+    std::size_t index,
     Renderer::GenericBuffer& particles,
     Renderer::Texture& levelSet,
     Renderer::IndirectBuffer<Renderer::DispatchParams>& dispatchParams)
 {
-  mAdvectParticlesBound =
+  mParticles[index] = &particles;
+  mDispatchParams = &dispatchParams;
+  mAdvectParticlesBound[index] =
       mAdvectParticles.Bind(mSize, {particles, dispatchParams, mVelocity, levelSet});
-  mAdvectParticlesCmd.Record([&](vk::CommandBuffer commandBuffer) {
+  RecordAdvectParticles(index);
+}
+
+void Advection::RecordAdvectParticles(std::size_t index)
+{
+  mAdvectParticlesCmd[index].Record([&](vk::CommandBuffer commandBuffer) {
     commandBuffer.debugMarkerBeginEXT({"Particle advect", {{0.09f, 0.17f, 0.36f, 1.0f}}},
                                       mDevice.Loader());
-    mAdvectParticlesBound.PushConstant(commandBuffer, mDt);
-    mAdvectParticlesBound.RecordIndirect(commandBuffer, dispatchParams);
-    particles.Barrier(
+    mAdvectParticlesBound[index].PushConstant(
+        commandBuffer, mDt, mParticleCfl, mParticleMaxSubSteps);
+    mAdvectParticlesBound[index].RecordIndirect(commandBuffer, *mDispatchParams);
+    mParticles[index]->Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     commandBuffer.debugMarkerEndEXT(mDevice.Loader());
   });
@@ -98,7 +313,24 @@ void Advection::AdvectParticleBind(
 
 void Advection::AdvectParticles()
 {
-  mAdvectParticlesCmd.Submit();
+  // The particles are bound to the velocity field itself
+  mVelocity.Resolve();
+  mAdvectParticlesCmd[mParticleCount ? mParticleCount->GetParticlesIndex() : 0].Submit();
+}
+
+void Advection::SetParticleSubSteps(float cfl, int maxSubSteps)
+{
+  mDevice.Queue().waitIdle();
+  mParticleCfl = cfl;
+  mParticleMaxSubSteps = std::max(maxSubSteps, 1);
+
+  for (std::size_t i = 0; i < mParticles.size(); i++)
+  {
+    if (mParticles[i])
+    {
+      RecordAdvectParticles(i);
+    }
+  }
 }
 
 }  // namespace Fluid
@@ -10,14 +10,37 @@
 #include <Vortex2D/Renderer/CommandBuffer.h>
 #include <Vortex2D/Renderer/Work.h>
 
+#include <Vortex2D/Engine/Particles.h>
 #include <Vortex2D/Engine/Velocity.h>
 
+#include <array>
+#include <memory>
+#include <vector>
+
 namespace Vortex2D
 {
 namespace Fluid
 {
 class Density;
 
+/**
+ * @brief Advection scheme of the velocity and density fields.
+ */
+enum class AdvectionMode
+{
+  /**
+   * @brief Semi-Lagrangian advection with the interpolation of the velocity
+   */
+  SemiLagrangian = 0,
+  /**
+   * @brief MacCormack advection: the semi-Lagrangian advection is written to a
+   * temporary texture, then corrected in a second dispatch with the error
+   * estimated by advecting it back, with a min-max limiter. Less diffusive,
+   * for two more traces per cell and a temporary texture per field.
+   */
+  MacCormack = 1,
+};
+
 /**
  * @brief Advects particles, velocity field or any field using a velocity field.
  */
@@ -30,27 +53,38 @@ public:
    * @param size size of velocity field
    * @param dt delta time for integration
    * @param velocity velocity field
+   * @param particleLayout layout of the advected particles
+   * @param particleTransfer transfer of the advected particles
    */
   VORTEX2D_API Advection(const Renderer::Device& device,
                          const glm::ivec2& size,
                          float dt,
                          Velocity& velocity,
-                         Velocity::InterpolationMode interpolationMode);
+                         Velocity::InterpolationMode interpolationMode,
+                         ParticleLayout particleLayout = ParticleLayout::Interleaved,
+                         ParticleTransfer particleTransfer = ParticleTransfer::PicFlip);
+
+  /**
+   * @brief Set the advection scheme of the velocity and density fields.
+   * @param mode the advection mode
+   */
+  VORTEX2D_API void SetMode(AdvectionMode mode);
 
   /**
-   * @brief Self advect velocity
+   * @brief Self advect velocity, into the back field of the velocity which is
+   * then swapped with the front one.
    */
   VORTEX2D_API void AdvectVelocity();
 
-  // TODO can only advect one field, need to be able to do as many as we want
   /**
-   * @brief Binds a density field to be advected.
+   * @brief Binds a density field to be advected. Multiple fields can be bound,
+   * they are advected together and share the trace of the characteristics.
    * @param density density field
    */
   VORTEX2D_API void AdvectBind(Density& density);
 
   /**
-   * @brief Performs an advection of the density field. Asynchronous operation.
+   * @brief Performs an advection of the density fields. Asynchronous operation.
    */
   VORTEX2D_API void Advect();
 
@@ -65,27 +99,69 @@ public:
       Renderer::GenericBuffer& particles,
       Renderer::Texture& levelSet,
       Renderer::IndirectBuffer<Renderer::DispatchParams>& dispatchParams);
+
+  /**
+   * @brief Binds the double buffered particles of a particle count. The
+   * particles advected are the current ones when calling @ref AdvectParticles.
+   * @param particleCount particle count with the particles to be advected
+   * @param levelSet level set to project out particles
+   */
+  VORTEX2D_API void AdvectParticleBind(ParticleCount& particleCount, Renderer::Texture& levelSet);
+
   /**
    * @brief Advect particles. Asynchrounous operation.
    */
   VORTEX2D_API void AdvectParticles();
 
+  /**
+   * @brief Sub-cycle the particle advection: each particle takes steps moving
+   * it at most cfl cells, based on its local velocity, so fast particles stay
+   * accurate without sub-stepping the whole simulation.
+   * @param cfl maximum number of cells moved per step, 0 to advect with a
+   * single step
+   * @param maxSubSteps maximum number of steps per particle, the last step
+   * covers the remaining time
+   */
+  VORTEX2D_API void SetParticleSubSteps(float cfl, int maxSubSteps = 8);
+
 private:
+  void RecordVelocityAdvect();
+  void RecordAdvect();
+  void RecordAdvectParticles(std::size_t index);
+  void AdvectParticleBind(std::size_t index,
+                          Renderer::GenericBuffer& particles,
+                          Renderer::Texture& levelSet,
+                          Renderer::IndirectBuffer<Renderer::DispatchParams>& dispatchParams);
+
   const Renderer::Device& mDevice;
   float mDt;
   glm::ivec2 mSize;
   Velocity& mVelocity;
+  AdvectionMode mMode;
 
   Renderer::Work mVelocityAdvect;
-  Renderer::Work::Bound mVelocityAdvectBound;
+  std::array<Renderer::Work::Bound, 2> mVelocityAdvectBound;
+  Renderer::Work mVelocityMacCormack;
+  std::unique_ptr<Renderer::Texture> mVelocityHat;
+  std::array<Renderer::Work::Bound, 2> mVelocityHatBound;
+  std::array<Renderer::Work::Bound, 2> mVelocityMacCormackBound;
   Renderer::Work mAdvect;
-  Renderer::Work::Bound mAdvectBound;
+  std::vector<Density*> mDensities;
+  std::vector<std::unique_ptr<Renderer::Texture>> mFieldHats;
+  std::array<std::vector<Renderer::Work::Bound>, 2> mAdvectBound;
+  Renderer::Work mMacCormack;
+  std::array<std::vector<Renderer::Work::Bound>, 2> mMacCormackBound;
   Renderer::Work mAdvectParticles;
-  Renderer::Work::Bound mAdvectParticlesBound;
+  std::array<Renderer::Work::Bound, 2> mAdvectParticlesBound;
+  std::array<Renderer::GenericBuffer*, 2> mParticles;
+  Renderer::IndirectBuffer<Renderer::DispatchParams>* mDispatchParams;
+  ParticleCount* mParticleCount;
+  float mParticleCfl;
+  int mParticleMaxSubSteps;
 
-  Renderer::CommandBuffer mAdvectVelocityCmd;
-  Renderer::CommandBuffer mAdvectCmd;
-  Renderer::CommandBuffer mAdvectParticlesCmd;
+  std::vector<Renderer::CommandBuffer> mAdvectVelocityCmd;
+  std::vector<Renderer::CommandBuffer> mAdvectCmd;
+  std::vector<Renderer::CommandBuffer> mAdvectParticlesCmd;
 };
 
 }  // namespace Fluid
@@ -15,11 +15,16 @@ Cfl::Cfl(const Renderer::Device& device, const glm::ivec2& size, Velocity& veloc
     : mDevice(device)
     , mSize(size)
     , mVelocity(velocity)
-    , mVelocityMaxWork(device, size, SPIRV::VelocityMax_comp)
+    , mVelocityMaxWork(device,
+                       size,
+                       VelocityShader(velocity.GetPrecision(),
+                                      SPIRV::VelocityMax_comp,
+                                      SPIRV::VelocityMaxHalf_comp))
     , mVelocityMax(device, size.x * size.y)
-    , mCfl(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , mCfl(device, 1)
     , mVelocityMaxCmd(device, true)
     , mReduceVelocityMax(device, size)
+    , mCflReadback(device, mCfl)
 {
   mVelocityMaxBound = mVelocityMaxWork.Bind({mVelocity, mVelocityMax});
   mReduceVelocityMaxBound = mReduceVelocityMax.Bind(mVelocityMax, mCfl);
@@ -35,17 +40,30 @@ Cfl::Cfl(const Renderer::Device& device, const glm::ivec2& size, Velocity& veloc
 
 void Cfl::Compute()
 {
+  mVelocity.Resolve();
   mVelocityMaxCmd.Submit();
+  mCflReadback.Submit();
 }
 
 float Cfl::Get()
 {
-  mVelocityMaxCmd.Wait();
+  mCflReadback.Wait();
 
-  float cfl;
-  Renderer::CopyTo(mCfl, cfl);
+  float cfl = 0.0f;
+  GetLatest(cfl);
+  return cfl;
+}
+
+bool Cfl::GetLatest(float& cfl)
+{
+  float maxVelocity;
+  if (!mCflReadback.Get(maxVelocity))
+  {
+    return false;
+  }
 
-  return 1.0f / (cfl * mSize.x);
+  cfl = 1.0f / (maxVelocity * mSize.x);
+  return true;
 }
 
 }  // namespace Fluid
@@ -9,6 +9,7 @@
 #include <Vortex2D/Engine/LinearSolver/Reduce.h>
 #include <Vortex2D/Engine/Velocity.h>
 #include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Readback.h>
 #include <Vortex2D/Renderer/Work.h>
 
 namespace Vortex2D
@@ -36,6 +37,14 @@ public:
    */
   VORTEX2D_API float Get();
 
+  /**
+   * Returns the CFL number of a previous @ref Compute, read back without
+   * waiting. Non-blocking.
+   * @param cfl cfl number, unchanged if none was read back yet
+   * @return if a cfl number was read back
+   */
+  VORTEX2D_API bool GetLatest(float& cfl);
+
 private:
   const Renderer::Device& mDevice;
   glm::ivec2 mSize;
@@ -46,6 +55,7 @@ private:
   Renderer::CommandBuffer mVelocityMaxCmd;
   ReduceMax mReduceVelocityMax;
   ReduceMax::Bound mReduceVelocityMaxBound;
+  Renderer::Readback mCflReadback;
 };
 
 }  // namespace Fluid
@@ -0,0 +1,439 @@
+//
+//  Checkpoint.cpp
+//  Vortex2D
+//
+
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+namespace
+{
+const char Magic[4] = {'V', 'X', 'C', 'K'};
+const uint32_t Version = 1;
+const uint32_t CompressedFlag = 1;
+
+// Run-length encoding: a control byte c < 128 is followed by c + 1 literal
+// bytes, otherwise the next byte is repeated c - 125 times.
+std::vector<uint8_t> Compress(const std::vector<uint8_t>& data)
+{
+  std::vector<uint8_t> output;
+  std::size_t i = 0;
+  while (i < data.size())
+  {
+    std::size_t run = 1;
+    while (i + run < data.size() && run < 130 && data[i + run] == data[i])
+    {
+      run++;
+    }
+
+    if (run >= 3)
+    {
+      output.push_back(static_cast<uint8_t>(run + 125));
+      output.push_back(data[i]);
+      i += run;
+      continue;
+    }
+
+    std::size_t begin = i;
+    while (i < data.size() && i - begin < 128)
+    {
+      if (i + 2 < data.size() && data[i] == data[i + 1] && data[i] == data[i + 2])
+      {
+        break;
+      }
+      i++;
+    }
+
+    output.push_back(static_cast<uint8_t>(i - begin - 1));
+    output.insert(output.end(), data.begin() + begin, data.begin() + i);
+  }
+
+  return output;
+}
+
+void Decompress(const std::vector<uint8_t>& input, std::vector<uint8_t>& data)
+{
+  std::size_t j = 0;
+  for (std::size_t i = 0; i < input.size();)
+  {
+    uint8_t control = input[i++];
+    std::size_t count = control < 128 ? control + 1 : control - 125;
+    if (j + count > data.size() || i + (control < 128 ? count : 1) > input.size())
+    {
+      throw std::runtime_error("Corrupted checkpoint chunk");
+    }
+
+    if (control < 128)
+    {
+      std::copy(input.begin() + i, input.begin() + i + count, data.begin() + j);
+      i += count;
+    }
+    else
+    {
+      std::fill(data.begin() + j, data.begin() + j + count, input[i++]);
+    }
+    j += count;
+  }
+
+  if (j != data.size())
+  {
+    throw std::runtime_error("Corrupted checkpoint chunk");
+  }
+}
+
+template <typename T>
+void WriteValue(std::ofstream& file, const T& value)
+{
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T ReadValue(std::ifstream& file)
+{
+  T value;
+  if (!file.read(reinterpret_cast<char*>(&value), sizeof(T)))
+  {
+    throw std::runtime_error("Truncated checkpoint");
+  }
+  return value;
+}
+
+vk::DeviceSize TextureSize(Renderer::Texture& texture)
+{
+  return texture.GetWidth() * texture.GetHeight() * Renderer::GetBytesPerPixel(texture.GetFormat());
+}
+}  // namespace
+
+Checkpoint::Checkpoint(const Renderer::Device& device)
+    : mDevice(device), mDownload(device, true), mUpload(device, true), mRecorded(false)
+{
+}
+
+Checkpoint::Chunk* Checkpoint::Find(const std::string& name)
+{
+  for (auto& chunk : mChunks)
+  {
+    if (chunk->Name == name)
+    {
+      return chunk.get();
+    }
+  }
+
+  return nullptr;
+}
+
+void Checkpoint::Add(const std::string& name, Renderer::Texture& texture)
+{
+  if (Find(name))
+  {
+    throw std::runtime_error("Duplicate checkpoint chunk " + name);
+  }
+
+  auto chunk = std::make_unique<Chunk>();
+  chunk->Name = name;
+  chunk->Texture = &texture;
+  chunk->StagingTexture = std::make_unique<Renderer::Texture>(mDevice,
+                                                              texture.GetWidth(),
+                                                              texture.GetHeight(),
+                                                              texture.GetFormat(),
+                                                              VMA_MEMORY_USAGE_CPU_ONLY);
+  mChunks.push_back(std::move(chunk));
+  mRecorded = false;
+}
+
+void Checkpoint::Add(const std::string& name, Renderer::GenericBuffer& buffer, bool resizable)
+{
+  if (Find(name))
+  {
+    throw std::runtime_error("Duplicate checkpoint chunk " + name);
+  }
+
+  auto chunk = std::make_unique<Chunk>();
+  chunk->Name = name;
+  chunk->Buffer = &buffer;
+  chunk->Resizable = resizable;
+  chunk->StagingBuffer = std::make_unique<Renderer::GenericBuffer>(
+      mDevice, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_ONLY, buffer.Size());
+  mChunks.push_back(std::move(chunk));
+  mRecorded = false;
+}
+
+void Checkpoint::SetHostData(const std::string& name, const std::vector<uint8_t>& data)
+{
+  auto* chunk = Find(name);
+  if (!chunk)
+  {
+    mChunks.push_back(std::make_unique<Chunk>());
+    chunk = mChunks.back().get();
+    chunk->Name = name;
+  }
+  else if (chunk->Texture || chunk->Buffer)
+  {
+    throw std::runtime_error("Checkpoint chunk " + name + " is not a host chunk");
+  }
+
+  chunk->Data = data;
+}
+
+const std::vector<uint8_t>& Checkpoint::GetHostData(const std::string& name) const
+{
+  static const std::vector<uint8_t> empty;
+  for (auto& chunk : mChunks)
+  {
+    if (chunk->Name == name)
+    {
+      return chunk->Data;
+    }
+  }
+
+  return empty;
+}
+
+std::size_t Checkpoint::GetSize(const std::string& name) const
+{
+  for (auto& chunk : mChunks)
+  {
+    if (chunk->Name == name)
+    {
+      return chunk->Data.size();
+    }
+  }
+
+  return 0;
+}
+
+void Checkpoint::ResizeStaging()
+{
+  // Buffers can be resized after they are added, e.g. the particles
+  for (auto& chunk : mChunks)
+  {
+    if (chunk->Buffer && chunk->StagingBuffer->Size() != chunk->Buffer->Size())
+    {
+      chunk->StagingBuffer = std::make_unique<Renderer::GenericBuffer>(
+          mDevice,
+          vk::BufferUsageFlagBits::eStorageBuffer,
+          VMA_MEMORY_USAGE_CPU_ONLY,
+          chunk->Buffer->Size());
+      mRecorded = false;
+    }
+  }
+}
+
+void Checkpoint::Record()
+{
+  mDownload.Record([&](vk::CommandBuffer commandBuffer) {
+    for (auto& chunk : mChunks)
+    {
+      if (chunk->Texture)
+        chunk->StagingTexture->CopyFrom(commandBuffer, *chunk->Texture);
+      else if (chunk->Buffer)
+        chunk->StagingBuffer->CopyFrom(commandBuffer, *chunk->Buffer);
+    }
+  });
+
+  mUpload.Record([&](vk::CommandBuffer commandBuffer) {
+    for (auto& chunk : mChunks)
+    {
+      if (chunk->Texture)
+        chunk->Texture->CopyFrom(commandBuffer, *chunk->StagingTexture);
+      else if (chunk->Buffer)
+        chunk->Buffer->CopyFrom(commandBuffer, *chunk->StagingBuffer);
+    }
+  });
+
+  mRecorded = true;
+}
+
+void Checkpoint::Download()
+{
+  mDownload.Wait();
+  ResizeStaging();
+  if (!mRecorded)
+  {
+    Record();
+  }
+
+  mDownload.Submit();
+}
+
+void Checkpoint::Write(const std::string& filename, bool compress)
+{
+  mDownload.Wait();
+
+  std::ofstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    throw std::runtime_error("Cannot write checkpoint " + filename);
+  }
+
+  file.write(Magic, sizeof(Magic));
+  WriteValue(file, Version);
+  WriteValue(file, static_cast<uint32_t>(mChunks.size()));
+
+  for (auto& chunk : mChunks)
+  {
+    if (chunk->Texture)
+    {
+      chunk->Data.resize(TextureSize(*chunk->Texture));
+      chunk->StagingTexture->CopyTo(chunk->Data.data());
+    }
+    else if (chunk->Buffer)
+    {
+      chunk->Data.resize(chunk->StagingBuffer->Size());
+      chunk->StagingBuffer->CopyTo(
+          0, chunk->Data.data(), static_cast<uint32_t>(chunk->Data.size()));
+    }
+
+    uint32_t flags = 0;
+    const std::vector<uint8_t>* data = &chunk->Data;
+    std::vector<uint8_t> compressed;
+    if (compress)
+    {
+      compressed = Compress(chunk->Data);
+      if (compressed.size() < chunk->Data.size())
+      {
+        flags |= CompressedFlag;
+        data = &compressed;
+      }
+    }
+
+    WriteValue(file, static_cast<uint32_t>(chunk->Name.size()));
+    file.write(chunk->Name.data(), chunk->Name.size());
+    WriteValue(file, flags);
+    WriteValue(file, static_cast<uint64_t>(chunk->Data.size()));
+    WriteValue(file, static_cast<uint64_t>(data->size()));
+    file.write(reinterpret_cast<const char*>(data->data()), data->size());
+  }
+
+  if (!file)
+  {
+    throw std::runtime_error("Error writing checkpoint " + filename);
+  }
+}
+
+void Checkpoint::Read(const std::string& filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    throw std::runtime_error("Cannot open checkpoint " + filename);
+  }
+
+  char magic[4];
+  if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, Magic))
+  {
+    throw std::runtime_error("Invalid checkpoint " + filename);
+  }
+
+  auto version = ReadValue<uint32_t>(file);
+  if (version != Version)
+  {
+    throw std::runtime_error("Unsupported checkpoint version " + std::to_string(version));
+  }
+
+  // Host chunks are replaced by the ones of the file
+  mChunks.erase(std::remove_if(mChunks.begin(),
+                               mChunks.end(),
+                               [](const std::unique_ptr<Chunk>& chunk) {
+                                 return !chunk->Texture && !chunk->Buffer;
+                               }),
+                mChunks.end());
+
+  std::set<std::string> found;
+  auto numChunks = ReadValue<uint32_t>(file);
+  for (uint32_t i = 0; i < numChunks; i++)
+  {
+    std::string name(ReadValue<uint32_t>(file), '\0');
+    if (!file.read(&name[0], name.size()))
+    {
+      throw std::runtime_error("Truncated checkpoint");
+    }
+
+    auto flags = ReadValue<uint32_t>(file);
+    auto size = ReadValue<uint64_t>(file);
+    auto storedSize = ReadValue<uint64_t>(file);
+
+    std::vector<uint8_t> stored(storedSize);
+    if (!file.read(reinterpret_cast<char*>(stored.data()), storedSize))
+    {
+      throw std::runtime_error("Truncated checkpoint");
+    }
+
+    auto* chunk = Find(name);
+    if (!chunk)
+    {
+      mChunks.push_back(std::make_unique<Chunk>());
+      chunk = mChunks.back().get();
+      chunk->Name = name;
+    }
+
+    if ((chunk->Texture && size != TextureSize(*chunk->Texture)) ||
+        (chunk->Buffer && !chunk->Resizable && size != chunk->Buffer->Size()))
+    {
+      throw std::runtime_error("Checkpoint chunk " + name + " has an invalid size");
+    }
+
+    if (flags & CompressedFlag)
+    {
+      chunk->Data.resize(size);
+      Decompress(stored, chunk->Data);
+    }
+    else if (storedSize == size)
+    {
+      chunk->Data = std::move(stored);
+    }
+    else
+    {
+      throw std::runtime_error("Checkpoint chunk " + name + " has an invalid size");
+    }
+
+    found.insert(name);
+  }
+
+  for (auto& chunk : mChunks)
+  {
+    if ((chunk->Texture || chunk->Buffer) && found.count(chunk->Name) == 0)
+    {
+      throw std::runtime_error("Checkpoint is missing chunk " + chunk->Name);
+    }
+  }
+}
+
+void Checkpoint::Upload()
+{
+  for (auto& chunk : mChunks)
+  {
+    if (chunk->Buffer && chunk->Data.size() != chunk->Buffer->Size())
+    {
+      throw std::runtime_error("Checkpoint chunk " + chunk->Name + " has an invalid size");
+    }
+  }
+
+  ResizeStaging();
+  if (!mRecorded)
+  {
+    Record();
+  }
+
+  for (auto& chunk : mChunks)
+  {
+    if (chunk->Texture)
+      chunk->StagingTexture->CopyFrom(chunk->Data.data());
+    else if (chunk->Buffer)
+      chunk->StagingBuffer->CopyFrom(
+          0, chunk->Data.data(), static_cast<uint32_t>(chunk->Data.size()));
+  }
+
+  mUpload.Submit().Wait();
+}
+
+}  // namespace Fluid
+}  // namespace Vortex2D
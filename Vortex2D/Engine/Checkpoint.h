@@ -0,0 +1,130 @@
+//
+//  Checkpoint.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_Checkpoint_h
+#define Vortex2D_Checkpoint_h
+
+#include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Common.h>
+#include <Vortex2D/Renderer/Device.h>
+#include <Vortex2D/Renderer/Texture.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * @brief Saves and restores a set of textures, buffers and host data to a
+ * binary file. The file starts with a version and is made of named chunks, one
+ * per resource, which can be run-length compressed.
+ *
+ * The resources are downloaded to host visible staging memory with @ref
+ * Download, which doesn't block: the copy is queued after the work already
+ * submitted and more work can be submitted before calling @ref Write.
+ */
+class Checkpoint
+{
+public:
+  VORTEX2D_API Checkpoint(const Renderer::Device& device);
+
+  /**
+   * @brief Add a texture to the checkpoint
+   * @param name unique name of the chunk
+   * @param texture the texture
+   */
+  VORTEX2D_API void Add(const std::string& name, Renderer::Texture& texture);
+
+  /**
+   * @brief Add a buffer to the checkpoint
+   * @param name unique name of the chunk
+   * @param buffer the buffer
+   * @param resizable if the chunk can have a different size than the buffer,
+   * which then has to be resized before @ref Upload, see @ref GetSize
+   */
+  VORTEX2D_API void Add(const std::string& name,
+                        Renderer::GenericBuffer& buffer,
+                        bool resizable = false);
+
+  /**
+   * @brief Set the data of a host chunk, written with the GPU resources.
+   * @param name unique name of the chunk
+   * @param data the chunk's data
+   */
+  VORTEX2D_API void SetHostData(const std::string& name, const std::vector<uint8_t>& data);
+
+  /**
+   * @brief Get the data of a host chunk, after @ref Read
+   * @param name name of the chunk
+   * @return the chunk's data, empty if there is no such chunk
+   */
+  VORTEX2D_API const std::vector<uint8_t>& GetHostData(const std::string& name) const;
+
+  /**
+   * @brief Get the size of a chunk, after @ref Read
+   * @param name name of the chunk
+   * @return size in bytes of the chunk's data, 0 if there is no such chunk
+   */
+  VORTEX2D_API std::size_t GetSize(const std::string& name) const;
+
+  /**
+   * @brief Submit the copy of the textures and buffers to the staging memory.
+   * Doesn't wait for the copy to finish.
+   */
+  VORTEX2D_API void Download();
+
+  /**
+   * @brief Wait for the last @ref Download and write all chunks to a file.
+   * @param filename path of the file
+   * @param compress run-length compress the chunks
+   */
+  VORTEX2D_API void Write(const std::string& filename, bool compress = false);
+
+  /**
+   * @brief Read all the chunks from a file. Each added texture and buffer must
+   * have a chunk of the right size. Other chunks are read as host chunks,
+   * replacing the host chunks of previous reads.
+   * @param filename path of the file
+   */
+  VORTEX2D_API void Read(const std::string& filename);
+
+  /**
+   * @brief Copy the data read with @ref Read to the textures and buffers.
+   * Waits for the copy to finish.
+   */
+  VORTEX2D_API void Upload();
+
+private:
+  struct Chunk
+  {
+    std::string Name;
+    Renderer::Texture* Texture = nullptr;
+    Renderer::GenericBuffer* Buffer = nullptr;
+    bool Resizable = false;
+    std::unique_ptr<Renderer::Texture> StagingTexture;
+    std::unique_ptr<Renderer::GenericBuffer> StagingBuffer;
+    std::vector<uint8_t> Data;
+  };
+
+  Chunk* Find(const std::string& name);
+  void Record();
+  void ResizeStaging();
+
+  const Renderer::Device& mDevice;
+  std::vector<std::unique_ptr<Chunk>> mChunks;
+  Renderer::CommandBuffer mDownload;
+  Renderer::CommandBuffer mUpload;
+  bool mRecorded;
+};
+
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
@@ -0,0 +1,150 @@
+//
+//  Emitters.cpp
+//  Vortex2D
+//
+
+#include "Emitters.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "vortex2d_generated_spirv.h"
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+namespace
+{
+// Number of emits in flight, each with its own buffers
+const std::size_t NumEmitBuffers = 3;
+}  // namespace
+
+ParticleEmitters::ParticleEmitters(const Renderer::Device& device,
+                                   const glm::ivec2& size,
+                                   ParticleCount& particleCount,
+                                   std::size_t capacity)
+    : mDevice(device)
+    , mCapacity(capacity)
+    , mEmitWork(device, size, SPIRV::ParticleEmit_comp)
+    , mNextId(0)
+    , mStep(0)
+    , mDirty(NumEmitBuffers, false)
+{
+  mEmitters.reserve(NumEmitBuffers);
+  mParams.reserve(NumEmitBuffers);
+  mEmitCmd.reserve(NumEmitBuffers);
+  for (std::size_t i = 0; i < NumEmitBuffers; i++)
+  {
+    mEmitters.emplace_back(device, capacity, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    mParams.emplace_back(device, 1, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    mEmitBound.push_back(mEmitWork.Bind(
+        {mParams[i], mEmitters[i], particleCount, particleCount.GetSpawnVelocity()}));
+    mEmitCmd.emplace_back(device, true);
+    mEmitCmd[i].Record([&](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Particle emit", {{0.26f, 0.58f, 0.83f, 1.0f}}},
+                                        mDevice.Loader());
+      mEmitBound[i].Record(commandBuffer);
+      particleCount.Barrier(commandBuffer,
+                            vk::ImageLayout::eGeneral,
+                            vk::AccessFlagBits::eShaderWrite,
+                            vk::ImageLayout::eGeneral,
+                            vk::AccessFlagBits::eShaderRead);
+      particleCount.GetSpawnVelocity().Barrier(commandBuffer,
+                                               vk::ImageLayout::eGeneral,
+                                               vk::AccessFlagBits::eShaderWrite,
+                                               vk::ImageLayout::eGeneral,
+                                               vk::AccessFlagBits::eShaderRead);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
+}
+
+void ParticleEmitters::SetDirty()
+{
+  std::fill(mDirty.begin(), mDirty.end(), true);
+}
+
+std::size_t ParticleEmitters::Find(int id) const
+{
+  return std::distance(mIds.begin(), std::find(mIds.begin(), mIds.end(), id));
+}
+
+int ParticleEmitters::Add(const ParticleEmitter& emitter, int lifetime)
+{
+  if (mLocalEmitters.size() == mCapacity)
+  {
+    throw std::runtime_error("Too many particle emitters");
+  }
+
+  mLocalEmitters.push_back(emitter);
+  mIds.push_back(mNextId);
+  mLifetimes.push_back(lifetime);
+  SetDirty();
+
+  return mNextId++;
+}
+
+void ParticleEmitters::Update(int id, const ParticleEmitter& emitter)
+{
+  auto index = Find(id);
+  if (index == mIds.size())
+  {
+    throw std::runtime_error("Unknown particle emitter");
+  }
+
+  mLocalEmitters[index] = emitter;
+  SetDirty();
+}
+
+void ParticleEmitters::Remove(int id)
+{
+  auto index = Find(id);
+  if (index != mIds.size())
+  {
+    mLocalEmitters.erase(mLocalEmitters.begin() + index);
+    mIds.erase(mIds.begin() + index);
+    mLifetimes.erase(mLifetimes.begin() + index);
+    SetDirty();
+  }
+}
+
+std::size_t ParticleEmitters::Size() const
+{
+  return mLocalEmitters.size();
+}
+
+void ParticleEmitters::Emit()
+{
+  if (mLocalEmitters.empty())
+  {
+    return;
+  }
+
+  // The buffers of this emit are read by the emit a ring ago, which has
+  // usually completed
+  auto index = static_cast<std::size_t>(mStep) % NumEmitBuffers;
+  mEmitCmd[index].Wait();
+  if (mDirty[index])
+  {
+    mEmitters[index].CopyFrom(
+        0,
+        mLocalEmitters.data(),
+        static_cast<uint32_t>(sizeof(ParticleEmitter) * mLocalEmitters.size()));
+    mDirty[index] = false;
+  }
+
+  Renderer::CopyFrom(mParams[index], glm::ivec2(static_cast<int>(mLocalEmitters.size()), mStep++));
+  mEmitCmd[index].Submit();
+
+  for (std::size_t i = mLifetimes.size(); i-- > 0;)
+  {
+    if (mLifetimes[i] > 0 && --mLifetimes[i] == 0)
+    {
+      Remove(mIds[i]);
+    }
+  }
+}
+
+}  // namespace Fluid
+}  // namespace Vortex2D
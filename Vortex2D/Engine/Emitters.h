@@ -0,0 +1,134 @@
+//
+//  Emitters.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_Emitters_h
+#define Vortex2D_Emitters_h
+
+#include <Vortex2D/Engine/Particles.h>
+#include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Work.h>
+
+#include <vector>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * @brief Shape of the area of a @ref ParticleEmitter
+ */
+enum class EmitterShape
+{
+  /**
+   * @brief Rectangle centred on the position, the size is the half extents
+   */
+  Rectangle = 0,
+  /**
+   * @brief Circle centred on the position, the size x is the radius
+   */
+  Circle = 1,
+};
+
+/**
+ * @brief A source or sink of particles, as laid out on the GPU.
+ */
+struct ParticleEmitter
+{
+  alignas(8) glm::vec2 Position;
+  alignas(8) glm::vec2 Size;
+  /**
+   * @brief Velocity of the emitted particles, in cells per second like the
+   * velocities drawn with @ref World::RecordVelocity
+   */
+  alignas(8) glm::vec2 Velocity;
+  /**
+   * @brief Particles added to each cell of the area per step, can be
+   * fractional. Negative to remove particles, e.g. -8 removes all of them.
+   */
+  float Rate;
+  EmitterShape Shape;
+};
+
+/**
+ * @brief Sources and sinks of particles, which add to the number of particles
+ * to add or remove in each cell of a @ref ParticleCount with a single compute
+ * dispatch, instead of drawing a shape per emitter. The particles are then
+ * added or removed by the next @ref ParticleCount::Scan.
+ *
+ * The emitters are uploaded to a ring of buffers, so @ref Emit doesn't wait
+ * for the previous emits to complete.
+ */
+class ParticleEmitters
+{
+public:
+  /**
+   * @brief Initialize the emitters of a particle count.
+   * @param device vulkan device
+   * @param size size of the grid
+   * @param particleCount the particles to add to or remove from
+   * @param capacity maximum number of emitters
+   */
+  VORTEX2D_API ParticleEmitters(const Renderer::Device& device,
+                                const glm::ivec2& size,
+                                ParticleCount& particleCount,
+                                std::size_t capacity = 256);
+
+  /**
+   * @brief Add an emitter.
+   * @param emitter the emitter
+   * @param lifetime number of calls to @ref Emit before the emitter is
+   * removed, -1 to keep it until @ref Remove
+   * @return id of the emitter
+   */
+  VORTEX2D_API int Add(const ParticleEmitter& emitter, int lifetime = -1);
+
+  /**
+   * @brief Change an emitter, e.g. to move it.
+   * @param id id returned by @ref Add
+   * @param emitter the new emitter
+   */
+  VORTEX2D_API void Update(int id, const ParticleEmitter& emitter);
+
+  /**
+   * @brief Remove an emitter, does nothing if it has expired.
+   * @param id id returned by @ref Add
+   */
+  VORTEX2D_API void Remove(int id);
+
+  /**
+   * @brief Number of emitters
+   */
+  VORTEX2D_API std::size_t Size() const;
+
+  /**
+   * @brief Add the particles of the emitters to the particle count and set
+   * their velocity. To call before @ref ParticleCount::Scan.
+   */
+  VORTEX2D_API void Emit();
+
+private:
+  std::size_t Find(int id) const;
+
+  void SetDirty();
+
+  const Renderer::Device& mDevice;
+  std::size_t mCapacity;
+  std::vector<Renderer::Buffer<ParticleEmitter>> mEmitters;
+  std::vector<Renderer::Buffer<glm::ivec2>> mParams;
+  Renderer::Work mEmitWork;
+  std::vector<Renderer::Work::Bound> mEmitBound;
+  std::vector<Renderer::CommandBuffer> mEmitCmd;
+  std::vector<ParticleEmitter> mLocalEmitters;
+  std::vector<int> mIds, mLifetimes;
+  int mNextId;
+  int mStep;
+  std::vector<bool> mDirty;
+};
+
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
@@ -4,12 +4,21 @@
 
 #include "Extrapolation.h"
 
+#include <algorithm>
+
 #include "vortex2d_generated_spirv.h"
 
 namespace Vortex2D
 {
 namespace Fluid
 {
+namespace
+{
+// Layers extrapolated by one dispatch at most: the halo of
+// ExtrapolateVelocity.comp minus the ring of cells used by the constraint
+const int MaxExtrapolateLayers = 3;
+}  // namespace
+
 Extrapolation::Extrapolation(const Renderer::Device& device,
                              const glm::ivec2& size,
                              Renderer::GenericBuffer& valid,
@@ -18,62 +27,133 @@ Extrapolation::Extrapolation(const Renderer::Device& device,
     : mDevice(device)
     , mValid(device, size.x * size.y)
     , mVelocity(velocity)
-    , mExtrapolateVelocity(device, size, SPIRV::ExtrapolateVelocity_comp)
-    , mExtrapolateVelocityBound(
-          mExtrapolateVelocity.Bind({valid, mValid, velocity, velocity.Output()}))
-    , mExtrapolateVelocityBackBound(
-          mExtrapolateVelocity.Bind({mValid, valid, velocity.Output(), velocity}))
-    , mConstrainVelocity(device, size, SPIRV::ConstrainVelocity_comp)
-    , mExtrapolateCmd(device, false)
-    , mConstrainCmd(device, false)
+    , mValidInput(valid)
+    , mIterations(iterations)
+    , mExtrapolateVelocity(device,
+                           Renderer::ComputeSize(size, glm::ivec2(16)),
+                           VelocityShader(velocity.GetPrecision(),
+                                          SPIRV::ExtrapolateVelocity_comp,
+                                          SPIRV::ExtrapolateVelocityHalf_comp))
+    , mConstrainVelocity(device,
+                         size,
+                         VelocityShader(velocity.GetPrecision(),
+                                        SPIRV::ConstrainVelocity_comp,
+                                        SPIRV::ConstrainVelocityHalf_comp))
+    , mExtrapolateConstrainVelocity(device,
+                                    Renderer::ComputeSize(size, glm::ivec2(16)),
+                                    VelocityShader(velocity.GetPrecision(),
+                                                   SPIRV::ExtrapolateConstrainVelocity_comp,
+                                                   SPIRV::ExtrapolateConstrainVelocityHalf_comp))
 {
-  mExtrapolateCmd.Record([&, iterations](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Extrapolate", {{0.60f, 0.87f, 0.12f, 1.0f}}},
-                                      mDevice.Loader());
-    for (int i = 0; i < iterations / 2; i++)
-    {
-      mExtrapolateVelocityBound.Record(commandBuffer);
-      velocity.Output().Barrier(commandBuffer,
-                                vk::ImageLayout::eGeneral,
-                                vk::AccessFlagBits::eShaderWrite,
-                                vk::ImageLayout::eGeneral,
-                                vk::AccessFlagBits::eShaderRead);
-      mValid.Barrier(
-          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-      mExtrapolateVelocityBackBound.Record(commandBuffer);
-      velocity.Barrier(commandBuffer,
-                       vk::ImageLayout::eGeneral,
-                       vk::AccessFlagBits::eShaderWrite,
-                       vk::ImageLayout::eGeneral,
-                       vk::AccessFlagBits::eShaderRead);
-      valid.Barrier(
-          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    }
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  // A command buffer for each front field of the velocity
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    auto& front = velocity.Field(i);
+    auto& back = velocity.Field(1 - i);
+    mExtrapolateVelocityBound[i] = mExtrapolateVelocity.Bind({valid, mValid, front, back});
+    mExtrapolateVelocityBackBound[i] = mExtrapolateVelocity.Bind({mValid, valid, back, front});
+
+    mExtrapolateCmd.emplace_back(device, false);
+    mConstrainCmd.emplace_back(device, false);
+    mExtrapolateConstrainCmd.emplace_back(device, false);
+
+    mExtrapolateCmd[i].Record([&, i](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Extrapolate", {{0.60f, 0.87f, 0.12f, 1.0f}}},
+                                        mDevice.Loader());
+      RecordExtrapolate(commandBuffer, i, false);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
+}
+
+void Extrapolation::RecordExtrapolate(vk::CommandBuffer commandBuffer,
+                                      std::size_t front,
+                                      bool constrain)
+{
+  // Several layers are extrapolated in each dispatch, over an even number
+  // of dispatches so the result ends up in the front velocity field and valid
+  // buffer.
+  int dispatches =
+      2 * ((mIterations + 2 * MaxExtrapolateLayers - 1) / (2 * MaxExtrapolateLayers));
+  if (constrain)
+  {
+    dispatches = std::max(dispatches, 2);
+  }
+
+  for (int i = 0; i < dispatches; i += 2)
+  {
+    int layers = mIterations / dispatches + (i < mIterations % dispatches ? 1 : 0);
+    mExtrapolateVelocityBound[front].PushConstant(commandBuffer, layers);
+    mExtrapolateVelocityBound[front].Record(commandBuffer);
+    mVelocity.Field(1 - front).Barrier(commandBuffer,
+                                       vk::ImageLayout::eGeneral,
+                                       vk::AccessFlagBits::eShaderWrite,
+                                       vk::ImageLayout::eGeneral,
+                                       vk::AccessFlagBits::eShaderRead);
+    mValid.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // The last dispatch also constrains the velocity
+    auto& bound = constrain && i + 2 == dispatches ? mExtrapolateConstrainVelocityBound[front]
+                                                    : mExtrapolateVelocityBackBound[front];
+    layers = mIterations / dispatches + (i + 1 < mIterations % dispatches ? 1 : 0);
+    bound.PushConstant(commandBuffer, layers);
+    bound.Record(commandBuffer);
+    mVelocity.Field(front).Barrier(commandBuffer,
+                                   vk::ImageLayout::eGeneral,
+                                   vk::AccessFlagBits::eShaderWrite,
+                                   vk::ImageLayout::eGeneral,
+                                   vk::AccessFlagBits::eShaderRead);
+    mValidInput.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+  }
 }
 
 void Extrapolation::Extrapolate()
 {
-  mExtrapolateCmd.Submit();
+  mExtrapolateCmd[mVelocity.Front()].Submit();
 }
 
 void Extrapolation::ConstrainBind(Renderer::Texture& solidPhi)
 {
-  mConstrainVelocityBound = mConstrainVelocity.Bind({solidPhi, mVelocity, mVelocity.Output()});
-
-  mConstrainCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Constrain Velocity", {{0.82f, 0.20f, 0.20f, 1.0f}}},
-                                      mDevice.Loader());
-    mConstrainVelocityBound.Record(commandBuffer);
-    mVelocity.CopyBack(commandBuffer);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    auto& front = mVelocity.Field(i);
+    auto& back = mVelocity.Field(1 - i);
+
+    mConstrainVelocityBound[i] = mConstrainVelocity.Bind({solidPhi, front, back});
+    mConstrainCmd[i].Record([&, i](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Constrain Velocity", {{0.82f, 0.20f, 0.20f, 1.0f}}},
+                                        mDevice.Loader());
+      mConstrainVelocityBound[i].Record(commandBuffer);
+      back.Barrier(commandBuffer,
+                   vk::ImageLayout::eGeneral,
+                   vk::AccessFlagBits::eShaderWrite,
+                   vk::ImageLayout::eGeneral,
+                   vk::AccessFlagBits::eShaderRead);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+
+    mExtrapolateConstrainVelocityBound[i] =
+        mExtrapolateConstrainVelocity.Bind({mValid, mValidInput, back, front, solidPhi});
+    mExtrapolateConstrainCmd[i].Record([&, i](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT(
+          {"Extrapolate and constrain", {{0.60f, 0.87f, 0.12f, 1.0f}}}, mDevice.Loader());
+      RecordExtrapolate(commandBuffer, i, true);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
 }
 
 void Extrapolation::ConstrainVelocity()
 {
-  mConstrainCmd.Submit();
+  mConstrainCmd[mVelocity.Front()].Submit();
+  mVelocity.Swap();
+}
+
+void Extrapolation::ExtrapolateConstrain()
+{
+  mExtrapolateConstrainCmd[mVelocity.Front()].Submit();
 }
 
 }  // namespace Fluid
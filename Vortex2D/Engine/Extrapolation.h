@@ -11,13 +11,17 @@
 #include <Vortex2D/Renderer/CommandBuffer.h>
 #include <Vortex2D/Renderer/Work.h>
 
+#include <array>
+#include <vector>
+
 namespace Vortex2D
 {
 namespace Fluid
 {
 /**
  * @brief Class to extrapolate values into the neumann and/or dirichlet
- * boundaries
+ * boundaries. Each dispatch extrapolates several layers in a tile kept in
+ * shared memory.
  */
 class Extrapolation
 {
@@ -30,7 +34,7 @@ public:
 
   /**
    * @brief Will extrapolate values from buffer into the dirichlet and neumann
-   * boundaries
+   * boundaries. The result stays in the front field of the velocity.
    */
   VORTEX2D_API void Extrapolate();
 
@@ -43,22 +47,37 @@ public:
 
   /**
    * @brief Constrain the velocity, i.e. ensure that the velocity normal to the
-   * solid level set is 0.
+   * solid level set is 0. The result is written to the back field of the
+   * velocity, which is then swapped with the front one.
    */
   VORTEX2D_API void ConstrainVelocity();
 
+  /**
+   * @brief Extrapolate and constrain the velocity, same as @ref Extrapolate
+   * followed by @ref ConstrainVelocity but the constraint is applied by the
+   * last extrapolation dispatch, without copying the velocity.
+   */
+  VORTEX2D_API void ExtrapolateConstrain();
+
 private:
+  void RecordExtrapolate(vk::CommandBuffer commandBuffer, std::size_t front, bool constrain);
+
   const Renderer::Device& mDevice;
   Renderer::Buffer<glm::ivec2> mValid;
   Velocity& mVelocity;
+  Renderer::GenericBuffer& mValidInput;
+  int mIterations;
 
   Renderer::Work mExtrapolateVelocity;
-  Renderer::Work::Bound mExtrapolateVelocityBound, mExtrapolateVelocityBackBound;
+  std::array<Renderer::Work::Bound, 2> mExtrapolateVelocityBound, mExtrapolateVelocityBackBound;
   Renderer::Work mConstrainVelocity;
-  Renderer::Work::Bound mConstrainVelocityBound;
+  std::array<Renderer::Work::Bound, 2> mConstrainVelocityBound;
+  Renderer::Work mExtrapolateConstrainVelocity;
+  std::array<Renderer::Work::Bound, 2> mExtrapolateConstrainVelocityBound;
 
-  Renderer::CommandBuffer mExtrapolateCmd;
-  Renderer::CommandBuffer mConstrainCmd;
+  std::vector<Renderer::CommandBuffer> mExtrapolateCmd;
+  std::vector<Renderer::CommandBuffer> mConstrainCmd;
+  std::vector<Renderer::CommandBuffer> mExtrapolateConstrainCmd;
 };
 
 }  // namespace Fluid
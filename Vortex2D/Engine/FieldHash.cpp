@@ -0,0 +1,67 @@
+//
+//  FieldHash.cpp
+//  Vortex2D
+//
+
+#include "FieldHash.h"
+
+#include "vortex2d_generated_spirv.h"
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+FieldHash::FieldHash(const Renderer::Device& device,
+                     const std::vector<std::reference_wrapper<Renderer::Texture>>& fields)
+    : mDevice(device)
+    , mHashWork(device, Renderer::ComputeSize::Default1D(), SPIRV::FieldHash_comp)
+    , mHash(device, 1, VMA_MEMORY_USAGE_GPU_TO_CPU)
+    , mHashCmd(device, true)
+{
+  for (auto& field : fields)
+  {
+    auto size = field.get().GetWidth() * field.get().GetHeight() *
+                Renderer::GetBytesPerPixel(field.get().GetFormat());
+    int count = static_cast<int>(size / sizeof(uint32_t));
+
+    mFieldData.push_back(std::make_unique<Renderer::GenericBuffer>(
+        device, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY, size));
+    mHashBounds.push_back(
+        mHashWork.Bind(Renderer::ComputeSize(count), {*mFieldData.back(), mHash}));
+  }
+
+  mHashCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    commandBuffer.debugMarkerBeginEXT({"Field hash", {{0.31f, 0.52f, 0.84f, 1.0f}}},
+                                      mDevice.Loader());
+
+    mHash.Clear(commandBuffer);
+    for (std::size_t i = 0; i < fields.size(); i++)
+    {
+      mFieldData[i]->CopyFrom(commandBuffer, fields[i].get());
+      mHashBounds[i].PushConstant(commandBuffer, static_cast<uint32_t>(i));
+      mHashBounds[i].Record(commandBuffer);
+      mHash.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    }
+
+    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+  });
+}
+
+void FieldHash::Compute()
+{
+  mHashCmd.Submit();
+}
+
+uint32_t FieldHash::Get()
+{
+  mHashCmd.Wait();
+
+  uint32_t hash;
+  Renderer::CopyTo(mHash, hash);
+
+  return hash;
+}
+
+}  // namespace Fluid
+}  // namespace Vortex2D
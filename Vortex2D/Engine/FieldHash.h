@@ -0,0 +1,57 @@
+//
+//  FieldHash.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_FieldHash_h
+#define Vortex2D_FieldHash_h
+
+#include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Texture.h>
+#include <Vortex2D/Renderer/Work.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * Calculates a hash of the content of several textures on the GPU. The hash
+ * doesn't depend on the order the GPU processes the pixels, so two runs with
+ * the same result give the same hash. Used to compare runs without
+ * downloading the fields.
+ */
+class FieldHash
+{
+public:
+  VORTEX2D_API FieldHash(const Renderer::Device& device,
+                         const std::vector<std::reference_wrapper<Renderer::Texture>>& fields);
+
+  /**
+   * Compute the hash. Non-blocking.
+   */
+  VORTEX2D_API void Compute();
+
+  /**
+   * Returns the hash. Blocking.
+   * @return hash of the fields
+   */
+  VORTEX2D_API uint32_t Get();
+
+private:
+  const Renderer::Device& mDevice;
+  Renderer::Work mHashWork;
+  std::vector<std::unique_ptr<Renderer::GenericBuffer>> mFieldData;
+  std::vector<Renderer::Work::Bound> mHashBounds;
+  Renderer::Buffer<uint32_t> mHash;
+  Renderer::CommandBuffer mHashCmd;
+};
+
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
@@ -0,0 +1,164 @@
+//
+//  Forces.cpp
+//  Vortex2D
+//
+
+#include "Forces.h"
+
+#include "vortex2d_generated_spirv.h"
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+Forces::Forces(const Renderer::Device& device,
+               const glm::ivec2& size,
+               float dt,
+               Velocity& velocity)
+    : mDevice(device)
+    , mDt(dt)
+    , mScale(1.0f / size.x)
+    , mVelocity(velocity)
+    , mGravity(0.0f)
+    , mDrag(0.0f)
+    , mVorticityStrength(0.0f)
+    , mVelocityForce(device,
+                     size,
+                     VelocityShader(velocity.GetPrecision(),
+                                    SPIRV::VelocityForce_comp,
+                                    SPIRV::VelocityForceHalf_comp))
+    , mBuoyancy(device,
+                size,
+                VelocityShader(
+                    velocity.GetPrecision(), SPIRV::Buoyancy_comp, SPIRV::BuoyancyHalf_comp))
+    , mVorticityConfinement(device,
+                            Renderer::ComputeSize(size, glm::ivec2(16)),
+                            VelocityShader(velocity.GetPrecision(),
+                                           SPIRV::VorticityConfinement_comp,
+                                           SPIRV::VorticityConfinementHalf_comp))
+    , mEnabled(false)
+{
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    mVelocityForceBound[i] = mVelocityForce.Bind({velocity.Field(i)});
+    mVorticityConfinementBound[i] =
+        mVorticityConfinement.Bind({velocity.Field(i), velocity.Field(1 - i)});
+    mForcesCmd.emplace_back(device, false);
+  }
+}
+
+void Forces::SetGravity(const glm::vec2& gravity)
+{
+  mGravity = gravity;
+  Record();
+}
+
+void Forces::SetDrag(float drag)
+{
+  mDrag = drag;
+  Record();
+}
+
+void Forces::SetVorticityConfinement(float strength)
+{
+  mVorticityStrength = strength;
+  Record();
+}
+
+void Forces::BuoyancyBind(Density& field, const glm::vec2& force, float ambient)
+{
+  Buoyancy buoyancy{{}, force, ambient};
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    buoyancy.Bound[i] = mBuoyancy.Bind({mVelocity.Field(i), field});
+  }
+
+  mBuoyancies.push_back(std::move(buoyancy));
+  Record();
+}
+
+void Forces::ClearBuoyancy()
+{
+  mDevice.Queue().waitIdle();
+  mBuoyancies.clear();
+  Record();
+}
+
+void Forces::Record()
+{
+  // The command buffer can't be recorded while it's in use
+  mDevice.Queue().waitIdle();
+
+  bool velocityForce = mGravity != glm::vec2(0.0f) || mDrag != 0.0f;
+  mEnabled = velocityForce || !mBuoyancies.empty() || mVorticityStrength != 0.0f;
+  if (!mEnabled)
+  {
+    return;
+  }
+
+  // A command buffer for each front field of the velocity
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    auto& front = mVelocity.Field(i);
+    auto& back = mVelocity.Field(1 - i);
+
+    mForcesCmd[i].Record([&, i, velocityForce](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Forces", {{0.85f, 0.55f, 0.25f, 1.0f}}},
+                                        mDevice.Loader());
+
+      // The velocity is stored divided by the width of the grid, as in
+      // World::RecordVelocity
+      if (velocityForce)
+      {
+        mVelocityForceBound[i].PushConstant(commandBuffer, mScale * mGravity, mDt, mDrag);
+        mVelocityForceBound[i].Record(commandBuffer);
+        front.Barrier(commandBuffer,
+                      vk::ImageLayout::eGeneral,
+                      vk::AccessFlagBits::eShaderWrite,
+                      vk::ImageLayout::eGeneral,
+                      vk::AccessFlagBits::eShaderRead);
+      }
+
+      for (auto& buoyancy : mBuoyancies)
+      {
+        buoyancy.Bound[i].PushConstant(
+            commandBuffer, mScale * buoyancy.Force, mDt, buoyancy.Ambient);
+        buoyancy.Bound[i].Record(commandBuffer);
+        front.Barrier(commandBuffer,
+                      vk::ImageLayout::eGeneral,
+                      vk::AccessFlagBits::eShaderWrite,
+                      vk::ImageLayout::eGeneral,
+                      vk::AccessFlagBits::eShaderRead);
+      }
+
+      // Reads the neighbouring velocities, so it's written to the back field
+      if (mVorticityStrength != 0.0f)
+      {
+        mVorticityConfinementBound[i].PushConstant(commandBuffer, mDt, mVorticityStrength);
+        mVorticityConfinementBound[i].Record(commandBuffer);
+        back.Barrier(commandBuffer,
+                     vk::ImageLayout::eGeneral,
+                     vk::AccessFlagBits::eShaderWrite,
+                     vk::ImageLayout::eGeneral,
+                     vk::AccessFlagBits::eShaderRead);
+      }
+
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
+}
+
+void Forces::Apply()
+{
+  if (mEnabled)
+  {
+    mForcesCmd[mVelocity.Front()].Submit();
+    if (mVorticityStrength != 0.0f)
+    {
+      mVelocity.Swap();
+    }
+  }
+}
+
+}  // namespace Fluid
+}  // namespace Vortex2D
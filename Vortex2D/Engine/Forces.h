@@ -0,0 +1,109 @@
+//
+//  Forces.h
+//  Vortex2D
+//
+
+#ifndef Vortex2d_Forces_h
+#define Vortex2d_Forces_h
+
+#include <Vortex2D/Engine/Density.h>
+#include <Vortex2D/Engine/Velocity.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/Work.h>
+
+#include <array>
+#include <vector>
+
+namespace Vortex2D
+{
+namespace Fluid
+{
+/**
+ * @brief Forces applied to the velocity each time step, without drawing to
+ * the velocity. Each enabled force is one compute dispatch, all recorded in
+ * one command buffer.
+ */
+class Forces
+{
+public:
+  VORTEX2D_API Forces(const Renderer::Device& device,
+                      const glm::ivec2& size,
+                      float dt,
+                      Velocity& velocity);
+
+  /**
+   * @brief Set a uniform acceleration, e.g. gravity
+   * @param gravity acceleration in cells per second squared
+   */
+  VORTEX2D_API void SetGravity(const glm::vec2& gravity);
+
+  /**
+   * @brief Set a linear drag slowing down the velocity
+   * @param drag fraction of the velocity lost per second
+   */
+  VORTEX2D_API void SetDrag(float drag);
+
+  /**
+   * @brief Set the vorticity confinement, which adds back the small scale
+   * swirls damped by the advection.
+   * @param strength strength of the confinement, 0 to disable it
+   */
+  VORTEX2D_API void SetVorticityConfinement(float strength);
+
+  /**
+   * @brief Add a buoyancy force proportional to a field, e.g. a smoke density
+   * making it sink or a temperature making it rise. Can be called for several
+   * fields.
+   * @param field the field, its first channel is used
+   * @param force acceleration in cells per second squared for a value of 1
+   * above the ambient value
+   * @param ambient value of the field without buoyancy
+   */
+  VORTEX2D_API void BuoyancyBind(Density& field, const glm::vec2& force, float ambient = 0.0f);
+
+  /**
+   * @brief Remove the buoyancy forces
+   */
+  VORTEX2D_API void ClearBuoyancy();
+
+  /**
+   * @brief Apply the enabled forces to the velocity. Does nothing if none is
+   * enabled. The vorticity confinement writes the back field of the velocity,
+   * which is then swapped with the front one.
+   */
+  VORTEX2D_API void Apply();
+
+private:
+  struct Buoyancy
+  {
+    std::array<Renderer::Work::Bound, 2> Bound;
+    glm::vec2 Force;
+    float Ambient;
+  };
+
+  void Record();
+
+  const Renderer::Device& mDevice;
+  float mDt;
+  float mScale;
+  Velocity& mVelocity;
+
+  glm::vec2 mGravity;
+  float mDrag;
+  float mVorticityStrength;
+
+  Renderer::Work mVelocityForce;
+  std::array<Renderer::Work::Bound, 2> mVelocityForceBound;
+  Renderer::Work mBuoyancy;
+  std::vector<Buoyancy> mBuoyancies;
+  Renderer::Work mVorticityConfinement;
+  std::array<Renderer::Work::Bound, 2> mVorticityConfinementBound;
+
+  std::vector<Renderer::CommandBuffer> mForcesCmd;
+  bool mEnabled;
+};
+
+}  // namespace Fluid
+}  // namespace Vortex2D
+
+#endif
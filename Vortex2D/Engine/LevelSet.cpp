@@ -10,69 +10,194 @@
 
 #include "vortex2d_generated_spirv.h"
 
+#include <algorithm>
+
 namespace Vortex2D
 {
 namespace Fluid
 {
+namespace
+{
+// Size of the tiles updated when redistancing, one work group each
+const glm::ivec2 RedistanceTileSize(16);
+
+int TileCount(const glm::ivec2& size)
+{
+  auto count = Renderer::ComputeSize::GetWorkSize(size, RedistanceTileSize);
+  return count.x * count.y;
+}
+
+// Each update converges its tile in shared memory, so the distances cross at
+// least one tile per pass. A path through the band can enter and leave tiles on
+// several sides, so twice the tiles across the band are recorded, and never
+// more than twice the tiles across the grid.
+int RedistancePasses(const glm::ivec2& size, int reinitializeIterations)
+{
+  auto count = Renderer::ComputeSize::GetWorkSize(size, RedistanceTileSize);
+  int bandTiles = (reinitializeIterations + RedistanceTileSize.x - 1) / RedistanceTileSize.x;
+  return 2 * std::min(bandTiles, count.x + count.y) + 2;
+}
+}  // namespace
+
 LevelSet::LevelSet(const Renderer::Device& device,
                    const glm::ivec2& size,
-                   int reinitializeIterations)
+                   int reinitializeIterations,
+                   Renderer::ResourcePool* pool)
     : Renderer::RenderTexture(device, size.x, size.y, vk::Format::eR32Sfloat)
     , mDevice(device)
-    , mLevelSet0(device, size.x, size.y, vk::Format::eR32Sfloat)
-    , mLevelSetBack(device, size.x, size.y, vk::Format::eR32Sfloat)
+    , mLevelSet0(
+          Renderer::AcquireTexture(pool, "LevelSet0", device, size, vk::Format::eR32Sfloat))
+    , mLevelSetBack(
+          Renderer::AcquireTexture(pool, "LevelSetBack", device, size, vk::Format::eR32Sfloat))
     , mSampler(Renderer::SamplerBuilder()
                    .AddressMode(vk::SamplerAddressMode::eClampToEdge)
                    .Create(device.Handle()))
-    , mExtrapolate(device, size, SPIRV::Extrapolate_comp)
-    , mRedistance(device, size, SPIRV::Redistance_comp)
-    , mRedistanceFront(
-          mRedistance.Bind({{*mSampler, mLevelSet0}, {*mSampler, *this}, mLevelSetBack}))
-    , mRedistanceBack(
-          mRedistance.Bind({{*mSampler, mLevelSet0}, {*mSampler, mLevelSetBack}, *this}))
-    , mShrinkWrap(device, size, SPIRV::ShrinkWrap_comp)
-    , mShrinkWrapBound(mShrinkWrap.Bind({{*mSampler, *this}, mLevelSetBack}))
+    , mTileActive(device, TileCount(size))
+    , mTileList(device, TileCount(size))
+    , mTileBand(device, TileCount(size))
+    , mBandList(device, TileCount(size))
+    , mRedistanceParams(device)
+    , mRedistanceParamsBack(device)
+    , mBandParams(device)
+    , mExtrapolate(device,
+                   Renderer::ComputeSize(size, RedistanceTileSize),
+                   SPIRV::Extrapolate_comp)
+    , mExtrapolateBand(device,
+                       Renderer::ComputeSize(size, RedistanceTileSize),
+                       SPIRV::Extrapolate_comp,
+                       Renderer::SpecConst(Renderer::SpecConstValue(3, 1)))
+    , mRedistanceInit(device,
+                      Renderer::ComputeSize(size, RedistanceTileSize),
+                      SPIRV::RedistanceInit_comp)
+    , mRedistanceInitBound(mRedistanceInit.Bind(
+          {*mLevelSet0, *this, mTileActive, mRedistanceParams, mBandParams}))
+    , mRedistanceTiles(device, Renderer::ComputeSize(TileCount(size)), SPIRV::RedistanceTiles_comp)
+    , mRedistanceTilesFront(mRedistanceTiles.Bind(
+          {mTileActive, mTileList, mRedistanceParams, mRedistanceParamsBack, mTileBand}))
+    , mRedistanceTilesBack(mRedistanceTiles.Bind(
+          {mTileActive, mTileList, mRedistanceParamsBack, mRedistanceParams, mTileBand}))
+    , mRedistanceUpdate(device,
+                        Renderer::ComputeSize(size, RedistanceTileSize),
+                        SPIRV::RedistanceUpdate_comp)
+    , mRedistanceUpdateBound(
+          mRedistanceUpdate.Bind({*mLevelSet0, *this, mTileActive, mTileList}))
+    , mRedistanceBand(device, Renderer::ComputeSize(TileCount(size)), SPIRV::RedistanceBand_comp)
+    , mRedistanceBandBound(mRedistanceBand.Bind({mTileBand, mBandList, mBandParams}))
+    , mShrinkWrap(device, Renderer::ComputeSize(size, RedistanceTileSize), SPIRV::ShrinkWrap_comp)
+    , mShrinkWrapBound(mShrinkWrap.Bind({{*mSampler, *this}, *mLevelSetBack, mBandList}))
+    , mShrinkWrapBand(device,
+                      Renderer::ComputeSize(size, RedistanceTileSize),
+                      SPIRV::ShrinkWrap_comp,
+                      Renderer::SpecConst(Renderer::SpecConstValue(3, 1)))
+    , mShrinkWrapBandBound(
+          mShrinkWrapBand.Bind({{*mSampler, *this}, *mLevelSetBack, mBandList}))
+    , mCopyBand(device, Renderer::ComputeSize(size, RedistanceTileSize), SPIRV::CopyBand_comp)
+    , mCopyBandBound(mCopyBand.Bind({*mLevelSetBack, *this, mBandList}))
     , mExtrapolateCmd(device, false)
+    , mExtrapolateBandCmd(device, false)
     , mReinitialiseCmd(device, false)
     , mShrinkWrapCmd(device, false)
+    , mShrinkWrapBandCmd(device, false)
+    , mVersion(0)
+    , mBandValid(false)
+    , mBandVersion(0)
+{
+  RecordReinitialise(reinitializeIterations);
+
+  mShrinkWrapCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    commandBuffer.debugMarkerBeginEXT({"Shrink Wrap", {{0.36f, 0.71f, 0.38f, 1.0f}}},
+                                      mDevice.Loader());
+    mShrinkWrapBound.Record(commandBuffer);
+    mLevelSetBack->Barrier(commandBuffer,
+                           vk::ImageLayout::eGeneral,
+                           vk::AccessFlagBits::eShaderWrite,
+                           vk::ImageLayout::eGeneral,
+                           vk::AccessFlagBits::eShaderRead);
+    CopyFrom(commandBuffer, *mLevelSetBack);
+    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+  });
+
+  // Only the band tiles are written to the back texture and copied back
+  mShrinkWrapBandCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    commandBuffer.debugMarkerBeginEXT({"Shrink Wrap", {{0.36f, 0.71f, 0.38f, 1.0f}}},
+                                      mDevice.Loader());
+    mShrinkWrapBandBound.RecordIndirect(commandBuffer, mBandParams);
+    mLevelSetBack->Barrier(commandBuffer,
+                           vk::ImageLayout::eGeneral,
+                           vk::AccessFlagBits::eShaderWrite,
+                           vk::ImageLayout::eGeneral,
+                           vk::AccessFlagBits::eShaderRead);
+    mCopyBandBound.RecordIndirect(commandBuffer, mBandParams);
+    Barrier(commandBuffer,
+            vk::ImageLayout::eGeneral,
+            vk::AccessFlagBits::eShaderWrite,
+            vk::ImageLayout::eGeneral,
+            vk::AccessFlagBits::eShaderRead);
+    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+  });
+}
+
+void LevelSet::RecordReinitialise(int reinitializeIterations)
 {
   mReinitialiseCmd.Record([&, reinitializeIterations](vk::CommandBuffer commandBuffer) {
     commandBuffer.debugMarkerBeginEXT({"Reinitialise", {{0.98f, 0.49f, 0.26f, 1.0f}}},
                                       mDevice.Loader());
 
-    mLevelSet0.CopyFrom(commandBuffer, *this);
+    mLevelSet0->CopyFrom(commandBuffer, *this);
 
-    for (int i = 0; i < reinitializeIterations / 2; i++)
+    mTileActive.Clear(commandBuffer);
+    mTileBand.Clear(commandBuffer);
+    mRedistanceInitBound.PushConstant(commandBuffer, static_cast<float>(reinitializeIterations));
+    mRedistanceInitBound.Record(commandBuffer);
+    Barrier(commandBuffer,
+            vk::ImageLayout::eGeneral,
+            vk::AccessFlagBits::eShaderWrite,
+            vk::ImageLayout::eGeneral,
+            vk::AccessFlagBits::eShaderRead);
+    mTileActive.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    mRedistanceParams.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+    // The active tiles are appended to one of the dispatch parameters while the
+    // other is reset for the next pass.
+    int passes = RedistancePasses(glm::ivec2(GetWidth(), GetHeight()), reinitializeIterations);
+    for (int i = 0; i < passes; i++)
     {
-      mRedistanceFront.PushConstant(commandBuffer, 0.1f);
-      mRedistanceFront.Record(commandBuffer);
-      mLevelSetBack.Barrier(commandBuffer,
-                            vk::ImageLayout::eGeneral,
-                            vk::AccessFlagBits::eShaderWrite,
-                            vk::ImageLayout::eGeneral,
-                            vk::AccessFlagBits::eShaderRead);
-      mRedistanceBack.PushConstant(commandBuffer, 0.1f);
-      mRedistanceBack.Record(commandBuffer);
+      auto& tilesBound = i % 2 == 0 ? mRedistanceTilesFront : mRedistanceTilesBack;
+      auto& params = i % 2 == 0 ? mRedistanceParams : mRedistanceParamsBack;
+      auto& nextParams = i % 2 == 0 ? mRedistanceParamsBack : mRedistanceParams;
+
+      tilesBound.Record(commandBuffer);
+      params.Barrier(commandBuffer,
+                     vk::AccessFlagBits::eShaderWrite,
+                     vk::AccessFlagBits::eIndirectCommandRead);
+      nextParams.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      mTileList.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      mTileActive.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+      mRedistanceUpdateBound.RecordIndirect(commandBuffer, params);
       Barrier(commandBuffer,
               vk::ImageLayout::eGeneral,
               vk::AccessFlagBits::eShaderWrite,
               vk::ImageLayout::eGeneral,
               vk::AccessFlagBits::eShaderRead);
+      mTileActive.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     }
 
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+    // The tiles updated at least once make the band
+    mTileBand.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    mRedistanceBandBound.Record(commandBuffer);
+    mBandParams.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead);
+    mBandList.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
-  mShrinkWrapCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Shrink Wrap", {{0.36f, 0.71f, 0.38f, 1.0f}}},
-                                      mDevice.Loader());
-    mShrinkWrapBound.Record(commandBuffer);
-    mLevelSetBack.Barrier(commandBuffer,
-                          vk::ImageLayout::eGeneral,
-                          vk::AccessFlagBits::eShaderWrite,
-                          vk::ImageLayout::eGeneral,
-                          vk::AccessFlagBits::eShaderRead);
-    CopyFrom(commandBuffer, mLevelSetBack);
     commandBuffer.debugMarkerEndEXT(mDevice.Loader());
   });
 }
@@ -83,22 +208,46 @@ LevelSet::LevelSet(LevelSet&& other)
     , mLevelSet0(std::move(other.mLevelSet0))
     , mLevelSetBack(std::move(other.mLevelSetBack))
     , mSampler(std::move(other.mSampler))
+    , mTileActive(std::move(other.mTileActive))
+    , mTileList(std::move(other.mTileList))
+    , mTileBand(std::move(other.mTileBand))
+    , mBandList(std::move(other.mBandList))
+    , mRedistanceParams(std::move(other.mRedistanceParams))
+    , mRedistanceParamsBack(std::move(other.mRedistanceParamsBack))
+    , mBandParams(std::move(other.mBandParams))
     , mExtrapolate(std::move(other.mExtrapolate))
     , mExtrapolateBound(std::move(other.mExtrapolateBound))
-    , mRedistance(std::move(other.mRedistance))
-    , mRedistanceFront(std::move(other.mRedistanceFront))
-    , mRedistanceBack(std::move(other.mRedistanceBack))
+    , mExtrapolateBand(std::move(other.mExtrapolateBand))
+    , mExtrapolateBandBound(std::move(other.mExtrapolateBandBound))
+    , mRedistanceInit(std::move(other.mRedistanceInit))
+    , mRedistanceInitBound(std::move(other.mRedistanceInitBound))
+    , mRedistanceTiles(std::move(other.mRedistanceTiles))
+    , mRedistanceTilesFront(std::move(other.mRedistanceTilesFront))
+    , mRedistanceTilesBack(std::move(other.mRedistanceTilesBack))
+    , mRedistanceUpdate(std::move(other.mRedistanceUpdate))
+    , mRedistanceUpdateBound(std::move(other.mRedistanceUpdateBound))
+    , mRedistanceBand(std::move(other.mRedistanceBand))
+    , mRedistanceBandBound(std::move(other.mRedistanceBandBound))
     , mShrinkWrap(std::move(other.mShrinkWrap))
     , mShrinkWrapBound(std::move(other.mShrinkWrapBound))
+    , mShrinkWrapBand(std::move(other.mShrinkWrapBand))
+    , mShrinkWrapBandBound(std::move(other.mShrinkWrapBandBound))
+    , mCopyBand(std::move(other.mCopyBand))
+    , mCopyBandBound(std::move(other.mCopyBandBound))
     , mExtrapolateCmd(std::move(other.mExtrapolateCmd))
+    , mExtrapolateBandCmd(std::move(other.mExtrapolateBandCmd))
     , mReinitialiseCmd(std::move(other.mReinitialiseCmd))
     , mShrinkWrapCmd(std::move(other.mShrinkWrapCmd))
+    , mShrinkWrapBandCmd(std::move(other.mShrinkWrapBandCmd))
+    , mVersion(other.mVersion)
+    , mBandValid(other.mBandValid)
+    , mBandVersion(other.mBandVersion)
 {
 }
 
 void LevelSet::ExtrapolateBind(Renderer::Texture& solidPhi)
 {
-  mExtrapolateBound = mExtrapolate.Bind({solidPhi, *this});
+  mExtrapolateBound = mExtrapolate.Bind({solidPhi, *this, mBandList});
   mExtrapolateCmd.Record([&](vk::CommandBuffer commandBuffer) {
     commandBuffer.debugMarkerBeginEXT({"Extrapolate phi", {{0.53f, 0.09f, 0.16f, 1.0f}}},
                                       mDevice.Loader());
@@ -110,21 +259,73 @@ void LevelSet::ExtrapolateBind(Renderer::Texture& solidPhi)
             vk::AccessFlagBits::eShaderRead);
     commandBuffer.debugMarkerEndEXT(mDevice.Loader());
   });
+
+  mExtrapolateBandBound = mExtrapolateBand.Bind({solidPhi, *this, mBandList});
+  mExtrapolateBandCmd.Record([&](vk::CommandBuffer commandBuffer) {
+    commandBuffer.debugMarkerBeginEXT({"Extrapolate phi", {{0.53f, 0.09f, 0.16f, 1.0f}}},
+                                      mDevice.Loader());
+    mExtrapolateBandBound.RecordIndirect(commandBuffer, mBandParams);
+    Barrier(commandBuffer,
+            vk::ImageLayout::eGeneral,
+            vk::AccessFlagBits::eShaderWrite,
+            vk::ImageLayout::eGeneral,
+            vk::AccessFlagBits::eShaderRead);
+    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+  });
 }
 
 void LevelSet::Reinitialise()
 {
   mReinitialiseCmd.Submit();
+  mBandValid = true;
+  mBandVersion = mVersion;
+}
+
+bool LevelSet::HasBand() const
+{
+  // Drawing to the level set can change it anywhere
+  return mBandValid && mBandVersion == mVersion;
+}
+
+void LevelSet::SetReinitializeIterations(int reinitializeIterations)
+{
+  mDevice.Queue().waitIdle();
+  RecordReinitialise(reinitializeIterations);
+}
+
+uint64_t LevelSet::GetVersion() const
+{
+  return mVersion;
+}
+
+void LevelSet::Submit(Renderer::RenderCommand& renderCommand)
+{
+  Renderer::RenderTexture::Submit(renderCommand);
+  mVersion++;
 }
 
 void LevelSet::ShrinkWrap()
 {
-  mShrinkWrapCmd.Submit();
+  if (HasBand())
+  {
+    mShrinkWrapBandCmd.Submit();
+  }
+  else
+  {
+    mShrinkWrapCmd.Submit();
+  }
 }
 
 void LevelSet::Extrapolate()
 {
-  mExtrapolateCmd.Submit();
+  if (HasBand())
+  {
+    mExtrapolateBandCmd.Submit();
+  }
+  else
+  {
+    mExtrapolateCmd.Submit();
+  }
 }
 
 }  // namespace Fluid
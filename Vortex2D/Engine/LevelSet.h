@@ -6,10 +6,14 @@
 #ifndef LevelSet_h
 #define LevelSet_h
 
+#include <Vortex2D/Renderer/Buffer.h>
 #include <Vortex2D/Renderer/CommandBuffer.h>
 #include <Vortex2D/Renderer/RenderTexture.h>
+#include <Vortex2D/Renderer/ResourcePool.h>
 #include <Vortex2D/Renderer/Work.h>
 
+#include <cstdint>
+
 namespace Vortex2D
 {
 namespace Fluid
@@ -17,13 +21,33 @@ namespace Fluid
 /**
  * @brief A signed distance field, which can be re-initialized. In other words,
  * a level set.
+ *
+ * Reinitialising uses the fast iterative method: the cells next to the
+ * interface keep their distance and the others are updated until the level set
+ * doesn't change anymore. The grid is split in tiles, each update sweeps a tile
+ * in shared memory until it converges and is dispatched indirectly over the
+ * tiles whose neighbours changed, so the work follows the interface and stops
+ * once the band is stable. Cells further away than the number of iterations
+ * are clamped to that distance. The tiles the redistancing went through make
+ * the band, and until the level set is drawn to again, @ref Extrapolate and
+ * @ref ShrinkWrap are only dispatched over those tiles. The level set and its
+ * temporaries are stored as full textures.
  */
 class LevelSet : public Renderer::RenderTexture
 {
 public:
+  /**
+   * @brief Initialize the level set.
+   * @param device vulkan device
+   * @param size size of the level set
+   * @param reinitializeIterations maximum number of iterations when
+   * reinitialising, which is also the width of the reinitialised band
+   * @param pool optional pool to share the temporary textures with
+   */
   VORTEX2D_API LevelSet(const Renderer::Device& device,
                         const glm::ivec2& size,
-                        int reinitializeIterations = 50);
+                        int reinitializeIterations = 50,
+                        Renderer::ResourcePool* pool = nullptr);
 
   VORTEX2D_API LevelSet(LevelSet&& other);
 
@@ -34,7 +58,26 @@ public:
   VORTEX2D_API void Reinitialise();
 
   /**
-   * @brief Shrink wrap wholes.
+   * @brief Set the maximum number of iterations when reinitialising, e.g. fewer
+   * when only a narrow band around the interface is needed. This is the width
+   * of the reinitialised band: after reinitialising, every cell further away
+   * from the interface is set to plus or minus that width, keeping its sign.
+   * @param reinitializeIterations maximum number of iterations
+   */
+  VORTEX2D_API void SetReinitializeIterations(int reinitializeIterations);
+
+  /**
+   * @brief Number of render commands submitted to the level set, used to know
+   * when it was drawn to.
+   * @return the version
+   */
+  VORTEX2D_API uint64_t GetVersion() const;
+
+  VORTEX2D_API void Submit(Renderer::RenderCommand& renderCommand) override;
+
+  /**
+   * @brief Shrink wrap wholes. Only the band tiles are updated after a
+   * reinitialisation.
    */
   VORTEX2D_API void ShrinkWrap();
 
@@ -47,28 +90,58 @@ public:
 
   /**
    * @brief Extrapolate this level set into the solid level set it was attached
-   * to. This only performs a single cell extrapolation.
+   * to. This only performs a single cell extrapolation. After a
+   * reinitialisation only the band tiles are updated: deeper cells are already
+   * negative and only the cells next to the interface change.
    */
   VORTEX2D_API void Extrapolate();
 
 private:
+  void RecordReinitialise(int reinitializeIterations);
+  bool HasBand() const;
+
   const Renderer::Device& mDevice;
-  Renderer::Texture mLevelSet0;
-  Renderer::Texture mLevelSetBack;
+  std::shared_ptr<Renderer::Texture> mLevelSet0;
+  std::shared_ptr<Renderer::Texture> mLevelSetBack;
 
   vk::UniqueSampler mSampler;
 
+  Renderer::Buffer<int> mTileActive;
+  Renderer::Buffer<int> mTileList;
+  Renderer::Buffer<int> mTileBand;
+  Renderer::Buffer<int> mBandList;
+  Renderer::IndirectBuffer<Renderer::DispatchParams> mRedistanceParams;
+  Renderer::IndirectBuffer<Renderer::DispatchParams> mRedistanceParamsBack;
+  Renderer::IndirectBuffer<Renderer::DispatchParams> mBandParams;
   Renderer::Work mExtrapolate;
   Renderer::Work::Bound mExtrapolateBound;
-  Renderer::Work mRedistance;
-  Renderer::Work::Bound mRedistanceFront;
-  Renderer::Work::Bound mRedistanceBack;
+  Renderer::Work mExtrapolateBand;
+  Renderer::Work::Bound mExtrapolateBandBound;
+  Renderer::Work mRedistanceInit;
+  Renderer::Work::Bound mRedistanceInitBound;
+  Renderer::Work mRedistanceTiles;
+  Renderer::Work::Bound mRedistanceTilesFront;
+  Renderer::Work::Bound mRedistanceTilesBack;
+  Renderer::Work mRedistanceUpdate;
+  Renderer::Work::Bound mRedistanceUpdateBound;
+  Renderer::Work mRedistanceBand;
+  Renderer::Work::Bound mRedistanceBandBound;
   Renderer::Work mShrinkWrap;
   Renderer::Work::Bound mShrinkWrapBound;
+  Renderer::Work mShrinkWrapBand;
+  Renderer::Work::Bound mShrinkWrapBandBound;
+  Renderer::Work mCopyBand;
+  Renderer::Work::Bound mCopyBandBound;
 
   Renderer::CommandBuffer mExtrapolateCmd;
+  Renderer::CommandBuffer mExtrapolateBandCmd;
   Renderer::CommandBuffer mReinitialiseCmd;
   Renderer::CommandBuffer mShrinkWrapCmd;
+  Renderer::CommandBuffer mShrinkWrapBandCmd;
+
+  uint64_t mVersion;
+  bool mBandValid;
+  uint64_t mBandVersion;
 };
 
 }  // namespace Fluid
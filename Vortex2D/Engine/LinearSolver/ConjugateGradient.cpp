@@ -15,13 +15,15 @@ namespace Fluid
 {
 ConjugateGradient::ConjugateGradient(const Renderer::Device& device,
                                      const glm::ivec2& size,
-                                     Preconditioner& preconditioner)
+                                     Preconditioner& preconditioner,
+                                     Renderer::ResourcePool* pool)
     : mDevice(device)
     , mPreconditioner(preconditioner)
-    , r(device, size.x * size.y)
-    , s(device, size.x * size.y)
-    , z(device, size.x * size.y)
-    , inner(device, size.x * size.y)
+    , r(Renderer::Acquire<Renderer::Buffer<float>>(pool, "PCG.r", device, size, size.x * size.y))
+    , s(Renderer::Acquire<Renderer::Buffer<float>>(pool, "PCG.s", device, size, size.x * size.y))
+    , z(Renderer::Acquire<Renderer::Buffer<float>>(pool, "PCG.z", device, size, size.x * size.y))
+    , inner(Renderer::Acquire<Renderer::Buffer<float>>(
+          pool, "PCG.inner", device, size, size.x * size.y))
     , alpha(device, 1)
     , beta(device, 1)
     , rho(device, 1)
@@ -34,18 +36,18 @@ ConjugateGradient::ConjugateGradient(const Renderer::Device& device,
     , scalarMultiply(device, size, SPIRV::Multiply_comp)
     , multiplyAdd(device, size, SPIRV::MultiplyAdd_comp)
     , multiplySub(device, size, SPIRV::MultiplySub_comp)
-    , reduceSum(device, size)
-    , reduceMax(device, size)
-    , reduceMaxBound(reduceMax.Bind(r, error))
-    , reduceSumRhoBound(reduceSum.Bind(inner, rho))
-    , reduceSumSigmaBound(reduceSum.Bind(inner, sigma))
-    , reduceSumRhoNewBound(reduceSum.Bind(inner, rho_new))
-    , multiplySBound(scalarMultiply.Bind({z, s, inner}))
-    , multiplyZBound(scalarMultiply.Bind({z, r, inner}))
+    , reduceSum(device, size, pool)
+    , reduceMax(device, size, pool)
+    , reduceMaxBound(reduceMax.Bind(*r, error))
+    , reduceSumRhoBound(reduceSum.Bind(*inner, rho))
+    , reduceSumSigmaBound(reduceSum.Bind(*inner, sigma))
+    , reduceSumRhoNewBound(reduceSum.Bind(*inner, rho_new))
+    , multiplySBound(scalarMultiply.Bind({*z, *s, *inner}))
+    , multiplyZBound(scalarMultiply.Bind({*z, *r, *inner}))
     , divideRhoBound(scalarDivision.Bind({rho, sigma, alpha}))
     , divideRhoNewBound(scalarDivision.Bind({rho_new, rho, beta}))
-    , multiplySubRBound(multiplySub.Bind({r, z, alpha, r}))
-    , multiplyAddZBound(multiplyAdd.Bind({z, s, beta, s}))
+    , multiplySubRBound(multiplySub.Bind({*r, *z, alpha, *r}))
+    , multiplyAddZBound(multiplyAdd.Bind({*z, *s, beta, *s}))
     , mSolveInit(device, false)
     , mSolve(device, false)
     , mErrorRead(device)
@@ -61,17 +63,17 @@ void ConjugateGradient::Bind(Renderer::GenericBuffer& d,
                              Renderer::GenericBuffer& b,
                              Renderer::GenericBuffer& pressure)
 {
-  mPreconditioner.Bind(d, l, r, z);
+  mPreconditioner.Bind(d, l, *r, *z);
 
-  matrixMultiplyBound = matrixMultiply.Bind({d, l, s, z});
-  multiplyAddPBound = multiplyAdd.Bind({pressure, s, alpha, pressure});
+  matrixMultiplyBound = matrixMultiply.Bind({d, l, *s, *z});
+  multiplyAddPBound = multiplyAdd.Bind({pressure, *s, alpha, pressure});
 
   mSolveInit.Record([&](vk::CommandBuffer commandBuffer) {
     commandBuffer.debugMarkerBeginEXT({"PCG Init", {{0.63f, 0.04f, 0.66f, 1.0f}}},
                                       mDevice.Loader());
 
     // r = b
-    r.CopyFrom(commandBuffer, b);
+    r->CopyFrom(commandBuffer, b);
 
     // calculate error
     reduceMaxBound.Record(commandBuffer);
@@ -80,18 +82,19 @@ void ConjugateGradient::Bind(Renderer::GenericBuffer& d,
     pressure.Clear(commandBuffer);
 
     // z = M^-1 r
-    z.Clear(commandBuffer);
+    z->Clear(commandBuffer);
     mPreconditioner.Record(commandBuffer);
-    z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    z->Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
     // s = z
-    s.CopyFrom(commandBuffer, z);
+    s->CopyFrom(commandBuffer, *z);
 
     // rho = zTr
     multiplyZBound.Record(commandBuffer);
-    inner.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    inner->Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     reduceSumRhoBound.Record(commandBuffer);
-    z.Clear(commandBuffer);
+    z->Clear(commandBuffer);
 
     commandBuffer.debugMarkerEndEXT(mDevice.Loader());
   });
@@ -102,11 +105,12 @@ void ConjugateGradient::Bind(Renderer::GenericBuffer& d,
 
     // z = As
     matrixMultiplyBound.Record(commandBuffer);
-    z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    z->Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
     // sigma = zTs
     multiplySBound.Record(commandBuffer);
-    inner.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    inner->Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     reduceSumSigmaBound.Record(commandBuffer);
 
     // alpha = rho / sigma
@@ -120,19 +124,20 @@ void ConjugateGradient::Bind(Renderer::GenericBuffer& d,
 
     // r = r - alpha * z
     multiplySubRBound.Record(commandBuffer);
-    r.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    r->Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
     // calculate max error
     reduceMaxBound.Record(commandBuffer);
 
     // z = M^-1 r
-    z.Clear(commandBuffer);
+    z->Clear(commandBuffer);
     mPreconditioner.Record(commandBuffer);
-    z.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    z->Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
     // rho_new = zTr
     multiplyZBound.Record(commandBuffer);
-    inner.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    inner->Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     reduceSumRhoNewBound.Record(commandBuffer);
 
     // beta = rho_new / rho
@@ -141,8 +146,8 @@ void ConjugateGradient::Bind(Renderer::GenericBuffer& d,
 
     // s = z + beta * s
     multiplyAddZBound.Record(commandBuffer);
-    z.Clear(commandBuffer);
-    s.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    z->Clear(commandBuffer);
+    s->Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
     // rho = rho_new
     rho.CopyFrom(commandBuffer, rho_new);
@@ -153,7 +158,7 @@ void ConjugateGradient::Bind(Renderer::GenericBuffer& d,
 
 void ConjugateGradient::BindRigidbody(float delta, Renderer::GenericBuffer& d, RigidBody& rigidBody)
 {
-  rigidBody.BindPressure(delta, d, s, z);
+  rigidBody.BindPressure(delta, d, *s, *z);
 }
 
 void ConjugateGradient::Solve(Parameters& params, const std::vector<RigidBody*>& rigidbodies)
@@ -29,10 +29,12 @@ public:
    * @param device vulkan device
    * @param size
    * @param preconditioner
+   * @param pool optional pool to share the temporary buffers with
    */
   VORTEX2D_API ConjugateGradient(const Renderer::Device& device,
                                  const glm::ivec2& size,
-                                 Preconditioner& preconditioner);
+                                 Preconditioner& preconditioner,
+                                 Renderer::ResourcePool* pool = nullptr);
 
   VORTEX2D_API ~ConjugateGradient() override;
 
@@ -56,7 +58,8 @@ private:
   const Renderer::Device& mDevice;
   Preconditioner& mPreconditioner;
 
-  Renderer::Buffer<float> r, s, z, inner, alpha, beta, rho, rho_new, sigma;
+  std::shared_ptr<Renderer::Buffer<float>> r, s, z, inner;
+  Renderer::Buffer<float> alpha, beta, rho, rho_new, sigma;
   Renderer::Buffer<float> error, localError;
   Renderer::Work matrixMultiply, scalarDivision, scalarMultiply, multiplyAdd, multiplySub;
   ReduceSum reduceSum;
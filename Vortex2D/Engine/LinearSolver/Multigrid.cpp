@@ -69,7 +69,8 @@ Multigrid::Multigrid(const Renderer::Device& device,
                      const glm::ivec2& size,
                      float delta,
                      int numSmoothingIterations,
-                     SmootherSolver smoother)
+                     SmootherSolver smoother,
+                     Renderer::ResourcePool* pool)
     : mDevice(device)
     , mDepth(size)
     , mDelta(delta)
@@ -86,21 +87,24 @@ Multigrid::Multigrid(const Renderer::Device& device,
   for (int i = 1; i <= mDepth.GetMaxDepth(); i++)
   {
     auto s = mDepth.GetDepthSize(i);
-    mDatas.emplace_back(device, s);
+    mDatas.push_back(Renderer::Acquire<LinearSolver::Data>(pool, "Multigrid.Data", device, s, s));
 
-    mSolidPhis.emplace_back(device, s);
-    mLiquidPhis.emplace_back(device, s);
+    mSolidPhis.push_back(
+        Renderer::Acquire<LevelSet>(pool, "Multigrid.SolidPhi", device, s, s, 50, pool));
+    mLiquidPhis.push_back(
+        Renderer::Acquire<LevelSet>(pool, "Multigrid.LiquidPhi", device, s, s, 50, pool));
   }
 
   for (int i = 0; i < mDepth.GetMaxDepth(); i++)
   {
     auto s = mDepth.GetDepthSize(i);
-    mResiduals.emplace_back(device, s.x * s.y);
+    mResiduals.push_back(Renderer::Acquire<Renderer::Buffer<float>>(
+        pool, "Multigrid.Residual", device, s, s.x * s.y));
     mSmoothers.emplace_back(MakeSmoother(device, s, smoother, numSmoothingIterations));
   }
 
   int depth = mDepth.GetMaxDepth() - 1;
-  mSmoother.Bind(mDatas[depth].Diagonal, mDatas[depth].Lower, mDatas[depth].B, mDatas[depth].X);
+  mSmoother.Bind(mDatas[depth]->Diagonal, mDatas[depth]->Lower, mDatas[depth]->B, mDatas[depth]->X);
   mResidualWorkBound.resize(mDepth.GetMaxDepth() + 1);
 }
 
@@ -114,12 +118,12 @@ void Multigrid::Bind(Renderer::GenericBuffer& d,
 {
   mPressure = &pressure;
 
-  mResidualWorkBound[0] = mResidualWork.Bind({pressure, d, l, b, mResiduals[0]});
+  mResidualWorkBound[0] = mResidualWork.Bind({pressure, d, l, b, *mResiduals[0]});
   mSmoothers[0]->Bind(d, l, b, pressure);
 
   auto s = mDepth.GetDepthSize(0);
-  mTransfer.RestrictBind(0, s, mResiduals[0], d, mDatas[0].B, mDatas[0].Diagonal);
-  mTransfer.ProlongateBind(0, s, pressure, d, mDatas[0].X, mDatas[0].Diagonal);
+  mTransfer.RestrictBind(0, s, *mResiduals[0], d, mDatas[0]->B, mDatas[0]->Diagonal);
+  mTransfer.ProlongateBind(0, s, pressure, d, mDatas[0]->X, mDatas[0]->Diagonal);
 
   mFullCycleSolver.Record([&](vk::CommandBuffer commandBuffer) {
     pressure.Clear(commandBuffer);
@@ -136,8 +140,8 @@ void Multigrid::BuildHierarchiesBind(Pressure& pressure,
                                      Renderer::Texture& liquidPhi)
 {
   auto s = mDepth.GetDepthSize(1);
-  mLiquidPhiScaleWorkBound.push_back(mPhiScaleWork.Bind(s, {liquidPhi, mLiquidPhis[0]}));
-  mSolidPhiScaleWorkBound.push_back(mPhiScaleWork.Bind(s, {solidPhi, mSolidPhis[0]}));
+  mLiquidPhiScaleWorkBound.push_back(mPhiScaleWork.Bind(s, {liquidPhi, *mLiquidPhis[0]}));
+  mSolidPhiScaleWorkBound.push_back(mPhiScaleWork.Bind(s, {solidPhi, *mSolidPhis[0]}));
 
   RecursiveBind(pressure, 1);
 
@@ -147,34 +151,34 @@ void Multigrid::BuildHierarchiesBind(Pressure& pressure,
     for (int i = 0; i < mDepth.GetMaxDepth(); i++)
     {
       mLiquidPhiScaleWorkBound[i].Record(commandBuffer);
-      mLiquidPhis[i].Barrier(commandBuffer,
+      mLiquidPhis[i]->Barrier(commandBuffer,
+                              vk::ImageLayout::eGeneral,
+                              vk::AccessFlagBits::eShaderWrite,
+                              vk::ImageLayout::eGeneral,
+                              vk::AccessFlagBits::eShaderRead);
+
+      mSolidPhiScaleWorkBound[i].Record(commandBuffer);
+      mSolidPhis[i]->Barrier(commandBuffer,
                              vk::ImageLayout::eGeneral,
                              vk::AccessFlagBits::eShaderWrite,
                              vk::ImageLayout::eGeneral,
                              vk::AccessFlagBits::eShaderRead);
 
-      mSolidPhiScaleWorkBound[i].Record(commandBuffer);
-      mSolidPhis[i].Barrier(commandBuffer,
-                            vk::ImageLayout::eGeneral,
-                            vk::AccessFlagBits::eShaderWrite,
-                            vk::ImageLayout::eGeneral,
-                            vk::AccessFlagBits::eShaderRead);
-
       mMatrixBuildBound[i].PushConstant(commandBuffer, mDelta);
       mMatrixBuildBound[i].Record(commandBuffer);
-      mDatas[i].Diagonal.Barrier(
+      mDatas[i]->Diagonal.Barrier(
           commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-      mDatas[i].Lower.Barrier(
+      mDatas[i]->Lower.Barrier(
           commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-      mDatas[i].B.Clear(commandBuffer);
+      mDatas[i]->B.Clear(commandBuffer);
     }
 
     int maxDepth = mDepth.GetMaxDepth();
     mMatrixBuildBound[maxDepth - 1].PushConstant(commandBuffer, mDelta);
     mMatrixBuildBound[maxDepth - 1].Record(commandBuffer);
-    mDatas[maxDepth - 1].Diagonal.Barrier(
+    mDatas[maxDepth - 1]->Diagonal.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    mDatas[maxDepth - 1].Lower.Barrier(
+    mDatas[maxDepth - 1]->Lower.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     commandBuffer.debugMarkerEndEXT(mDevice.Loader());
   });
@@ -188,44 +192,44 @@ void Multigrid::RecursiveBind(Pressure& pressure, std::size_t depth)
   {
     auto s1 = mDepth.GetDepthSize(depth + 1);
     mLiquidPhiScaleWorkBound.push_back(
-        mPhiScaleWork.Bind(s1, {mLiquidPhis[depth - 1], mLiquidPhis[depth]}));
+        mPhiScaleWork.Bind(s1, {*mLiquidPhis[depth - 1], *mLiquidPhis[depth]}));
     mSolidPhiScaleWorkBound.push_back(
-        mPhiScaleWork.Bind(s1, {mSolidPhis[depth - 1], mSolidPhis[depth]}));
+        mPhiScaleWork.Bind(s1, {*mSolidPhis[depth - 1], *mSolidPhis[depth]}));
 
     mResidualWorkBound[depth] = mResidualWork.Bind(s0,
-                                                   {mDatas[depth - 1].X,
-                                                    mDatas[depth - 1].Diagonal,
-                                                    mDatas[depth - 1].Lower,
-                                                    mDatas[depth - 1].B,
-                                                    mResiduals[depth]});
+                                                   {mDatas[depth - 1]->X,
+                                                    mDatas[depth - 1]->Diagonal,
+                                                    mDatas[depth - 1]->Lower,
+                                                    mDatas[depth - 1]->B,
+                                                    *mResiduals[depth]});
 
     mTransfer.RestrictBind(depth,
                            s0,
-                           mResiduals[depth],
-                           mDatas[depth - 1].Diagonal,
-                           mDatas[depth].B,
-                           mDatas[depth].Diagonal);
+                           *mResiduals[depth],
+                           mDatas[depth - 1]->Diagonal,
+                           mDatas[depth]->B,
+                           mDatas[depth]->Diagonal);
 
     mTransfer.ProlongateBind(depth,
                              s0,
-                             mDatas[depth - 1].X,
-                             mDatas[depth - 1].Diagonal,
-                             mDatas[depth].X,
-                             mDatas[depth].Diagonal);
+                             mDatas[depth - 1]->X,
+                             mDatas[depth - 1]->Diagonal,
+                             mDatas[depth]->X,
+                             mDatas[depth]->Diagonal);
 
-    mSmoothers[depth]->Bind(mDatas[depth - 1].Diagonal,
-                            mDatas[depth - 1].Lower,
-                            mDatas[depth - 1].B,
-                            mDatas[depth - 1].X);
+    mSmoothers[depth]->Bind(mDatas[depth - 1]->Diagonal,
+                            mDatas[depth - 1]->Lower,
+                            mDatas[depth - 1]->B,
+                            mDatas[depth - 1]->X);
 
     RecursiveBind(pressure, depth + 1);
   }
 
   mMatrixBuildBound.push_back(pressure.BindMatrixBuild(s0,
-                                                       mDatas[depth - 1].Diagonal,
-                                                       mDatas[depth - 1].Lower,
-                                                       mLiquidPhis[depth - 1],
-                                                       mSolidPhis[depth - 1]));
+                                                       mDatas[depth - 1]->Diagonal,
+                                                       mDatas[depth - 1]->Lower,
+                                                       *mLiquidPhis[depth - 1],
+                                                       *mSolidPhis[depth - 1]));
 }
 
 void Multigrid::BuildHierarchies()
@@ -284,12 +288,12 @@ void Multigrid::RecordVCycle(vk::CommandBuffer commandBuffer, int depth)
     Smoother(commandBuffer, depth);
 
     mResidualWorkBound[depth].Record(commandBuffer);
-    mResiduals[depth].Barrier(
+    mResiduals[depth]->Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
     mTransfer.Restrict(commandBuffer, depth);
 
-    mDatas[depth].X.Clear(commandBuffer);
+    mDatas[depth]->X.Clear(commandBuffer);
 
     RecordVCycle(commandBuffer, depth + 1);
 
@@ -302,17 +306,17 @@ void Multigrid::RecordVCycle(vk::CommandBuffer commandBuffer, int depth)
 void Multigrid::RecordFullCycle(vk::CommandBuffer commandBuffer)
 {
   mResidualWorkBound[0].Record(commandBuffer);
-  mResiduals[0].Barrier(
+  mResiduals[0]->Barrier(
       commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
 
   for (int i = 0; i < mDepth.GetMaxDepth() - 1; i++)
   {
     mTransfer.Restrict(commandBuffer, i);
-    mResiduals[i + 1].CopyFrom(commandBuffer, mDatas[i].B);
+    mResiduals[i + 1]->CopyFrom(commandBuffer, mDatas[i]->B);
   }
 
   int depth = mDepth.GetMaxDepth() - 1;
-  mDatas[depth].X.Clear(commandBuffer);
+  mDatas[depth]->X.Clear(commandBuffer);
   mSmoother.Record(commandBuffer);
 
   for (int i = depth; i >= 0; i--)
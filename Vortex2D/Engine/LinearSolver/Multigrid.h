@@ -72,12 +72,16 @@ public:
    * @param device vulkan device
    * @param size of the linear equations
    * @param delta timestep delta
+   * @param numSmoothingIterations number of smoothing iterations per level
+   * @param smoother the smoother type
+   * @param pool optional pool to share the hierarchy with
    */
   VORTEX2D_API Multigrid(const Renderer::Device& device,
                          const glm::ivec2& size,
                          float delta,
                          int numSmoothingIterations = 3,
-                         SmootherSolver smoother = SmootherSolver::Jacobi);
+                         SmootherSolver smoother = SmootherSolver::Jacobi,
+                         Renderer::ResourcePool* pool = nullptr);
 
   VORTEX2D_API ~Multigrid() override;
 
@@ -140,18 +144,18 @@ private:
   Renderer::GenericBuffer* mPressure = nullptr;
 
   // mDatas[0]  is level 1
-  std::vector<LinearSolver::Data> mDatas;
+  std::vector<std::shared_ptr<LinearSolver::Data>> mDatas;
 
   // mResiduals[0] is level 0
-  std::vector<Renderer::Buffer<float>> mResiduals;
+  std::vector<std::shared_ptr<Renderer::Buffer<float>>> mResiduals;
 
   Renderer::Work mPhiScaleWork;
   std::vector<Renderer::Work::Bound> mSolidPhiScaleWorkBound;
   std::vector<Renderer::Work::Bound> mLiquidPhiScaleWorkBound;
 
   // mSolidPhis[0] and mLiquidPhis[0] is level 1
-  std::vector<LevelSet> mSolidPhis;
-  std::vector<LevelSet> mLiquidPhis;
+  std::vector<std::shared_ptr<LevelSet>> mSolidPhis;
+  std::vector<std::shared_ptr<LevelSet>> mLiquidPhis;
 
   std::vector<Renderer::Work::Bound> mMatrixBuildBound;
 
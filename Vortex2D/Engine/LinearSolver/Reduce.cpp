@@ -32,16 +32,22 @@ Renderer::ComputeSize MakeComputeSize(int size)
 Reduce::Reduce(const Renderer::Device& device,
                const Renderer::SpirvBinary& spirv,
                const glm::ivec2& size,
-               std::size_t typeSize)
+               std::size_t typeSize,
+               const std::string& name,
+               Renderer::ResourcePool* pool)
     : mSize(size.x * size.y), mReduce(device, Renderer::ComputeSize::Default1D(), spirv)
 {
   auto computeSize = MakeComputeSize(mSize);
   while (computeSize.WorkSize.x > 1)
   {
-    mBuffers.emplace_back(device,
-                          vk::BufferUsageFlagBits::eStorageBuffer,
-                          VMA_MEMORY_USAGE_GPU_ONLY,
-                          typeSize * computeSize.WorkSize.x);
+    mBuffers.push_back(
+        Renderer::Acquire<Renderer::GenericBuffer>(pool,
+                                                   name,
+                                                   device,
+                                                   {computeSize.WorkSize.x, 1},
+                                                   vk::BufferUsageFlagBits::eStorageBuffer,
+                                                   VMA_MEMORY_USAGE_GPU_ONLY,
+                                                   typeSize * computeSize.WorkSize.x));
 
     computeSize = MakeComputeSize(computeSize.WorkSize.x);
   }
@@ -55,7 +61,7 @@ Reduce::Bound Reduce::Bind(Renderer::GenericBuffer& input, Renderer::GenericBuff
   buffers.push_back(&input);
   for (auto& buffer : mBuffers)
   {
-    buffers.push_back(&buffer);
+    buffers.push_back(buffer.get());
   }
   buffers.push_back(&output);
 
@@ -99,8 +105,10 @@ void Reduce::Bound::Record(vk::CommandBuffer commandBuffer)
   }
 }
 
-ReduceSum::ReduceSum(const Renderer::Device& device, const glm::ivec2& size)
-    : Reduce(device, SPIRV::Sum_comp, size, sizeof(float))
+ReduceSum::ReduceSum(const Renderer::Device& device,
+                     const glm::ivec2& size,
+                     Renderer::ResourcePool* pool)
+    : Reduce(device, SPIRV::Sum_comp, size, sizeof(float), "ReduceSum", pool)
 {
 }
 
@@ -111,13 +119,17 @@ struct J
   alignas(4) float angular;
 };
 
-ReduceJ::ReduceJ(const Renderer::Device& device, const glm::ivec2& size)
-    : Reduce(device, SPIRV::SumJ_comp, size, sizeof(J))
+ReduceJ::ReduceJ(const Renderer::Device& device,
+                 const glm::ivec2& size,
+                 Renderer::ResourcePool* pool)
+    : Reduce(device, SPIRV::SumJ_comp, size, sizeof(J), "ReduceJ", pool)
 {
 }
 
-ReduceMax::ReduceMax(const Renderer::Device& device, const glm::ivec2& size)
-    : Reduce(device, SPIRV::Max_comp, size, sizeof(float))
+ReduceMax::ReduceMax(const Renderer::Device& device,
+                     const glm::ivec2& size,
+                     Renderer::ResourcePool* pool)
+    : Reduce(device, SPIRV::Max_comp, size, sizeof(float), "ReduceMax", pool)
 {
 }
 
@@ -7,6 +7,7 @@
 #define Vortex2D_Reduce_h
 
 #include <Vortex2D/Renderer/CommandBuffer.h>
+#include <Vortex2D/Renderer/ResourcePool.h>
 #include <Vortex2D/Renderer/Work.h>
 
 namespace Vortex2D
@@ -60,12 +61,14 @@ protected:
   Reduce(const Renderer::Device& device,
          const Renderer::SpirvBinary& spirv,
          const glm::ivec2& size,
-         std::size_t typeSize);
+         std::size_t typeSize,
+         const std::string& name,
+         Renderer::ResourcePool* pool);
 
 private:
   int mSize;
   Renderer::Work mReduce;
-  std::vector<Renderer::GenericBuffer> mBuffers;
+  std::vector<std::shared_ptr<Renderer::GenericBuffer>> mBuffers;
 };
 
 /**
@@ -78,8 +81,11 @@ public:
    * @brief Initialize reduce with device and 2d size
    * @param device
    * @param size
+   * @param pool optional pool to share the scratch buffers with
    */
-  VORTEX2D_API ReduceSum(const Renderer::Device& device, const glm::ivec2& size);
+  VORTEX2D_API ReduceSum(const Renderer::Device& device,
+                         const glm::ivec2& size,
+                         Renderer::ResourcePool* pool = nullptr);
 };
 
 /**
@@ -93,8 +99,11 @@ public:
    * @brief Initialize reduce with device and 2d size
    * @param device
    * @param size
+   * @param pool optional pool to share the scratch buffers with
    */
-  VORTEX2D_API ReduceJ(const Renderer::Device& device, const glm::ivec2& size);
+  VORTEX2D_API ReduceJ(const Renderer::Device& device,
+                       const glm::ivec2& size,
+                       Renderer::ResourcePool* pool = nullptr);
 };
 
 /**
@@ -107,8 +116,11 @@ public:
    * @brief Initialize reduce with device and 2d size
    * @param device
    * @param size
+   * @param pool optional pool to share the scratch buffers with
    */
-  VORTEX2D_API ReduceMax(const Renderer::Device& device, const glm::ivec2& size);
+  VORTEX2D_API ReduceMax(const Renderer::Device& device,
+                         const glm::ivec2& size,
+                         Renderer::ResourcePool* pool = nullptr);
 };
 
 }  // namespace Fluid
@@ -7,78 +7,229 @@
 
 #include <Vortex2D/Engine/LevelSet.h>
 
+#include <algorithm>
 #include <random>
+#include <stdexcept>
 #include "vortex2d_generated_spirv.h"
 
 namespace Vortex2D
 {
 namespace Fluid
 {
+namespace
+{
+// Maximum number of particles per cell, see ParticleClamp.comp
+const int MaxParticlesPerCell = 8;
+
+// Tile size of the scatter particle to grid transfer
+const glm::ivec2 ScatterTileSize(16, 16);
+
+// Tile size of the Morton cell order, see CommonCells.comp
+const int MortonTileSize = 16;
+
+// Compact positions are 16 bit fixed point over the grid and one cell around
+// it, see CommonParticles.comp. Keep a resolution of at least 1/256 of a cell,
+// as positions are quantized again after each advection.
+const int MaxCompactSize = 65536 / 256 - 2;
+
+// Specialization constants of the particle storage and cell order, see
+// CommonParticles.comp and CommonCells.comp
+Renderer::SpecConstInfo ParticleSpecConst(ParticleLayout layout,
+                                          ParticleTransfer transfer,
+                                          ParticleCellOrder cellOrder)
+{
+  return Renderer::SpecConst(Renderer::SpecConstValue(4, static_cast<int>(layout)),
+                             Renderer::SpecConstValue(5, static_cast<int>(transfer)),
+                             Renderer::SpecConstValue(6, static_cast<int>(cellOrder)));
+}
+
+// Size of the per cell buffers, the Morton order pads the grid to whole tiles
+glm::ivec2 CellsSize(const glm::ivec2& size, ParticleCellOrder cellOrder)
+{
+  if (cellOrder == ParticleCellOrder::Morton)
+  {
+    return (size + MortonTileSize - 1) / MortonTileSize * MortonTileSize;
+  }
+
+  return size;
+}
+
+int CellsCount(const glm::ivec2& size, ParticleCellOrder cellOrder)
+{
+  auto cellsSize = CellsSize(size, cellOrder);
+  return cellsSize.x * cellsSize.y;
+}
+}  // namespace
+
 float DefaultParticleSize()
 {
   return 1.02f / std::sqrt(2.0f);
 }
 
+std::size_t GetBytesPerParticle(ParticleLayout layout, ParticleTransfer transfer)
+{
+  std::size_t bytes = layout == ParticleLayout::Compact ? 2 * sizeof(uint32_t) : sizeof(Particle);
+  if (transfer == ParticleTransfer::Apic)
+  {
+    // Gradients of the u and v velocity components
+    bytes *= 2;
+  }
+
+  return bytes;
+}
+
 ParticleCount::ParticleCount(const Renderer::Device& device,
                              const glm::ivec2& size,
                              Renderer::GenericBuffer& particles,
                              Velocity::InterpolationMode interpolationMode,
                              const Renderer::DispatchParams& params,
                              float alpha,
-                             float particleSize)
+                             float particleSize,
+                             ParticleLayout layout,
+                             ParticleToGridMode toGridMode,
+                             ParticleTransfer transfer,
+                             ParticleCellOrder cellOrder,
+                             ParticlePhiMode phiMode,
+                             Velocity::Precision velocityPrecision)
     : Renderer::RenderTexture(device, size.x, size.y, vk::Format::eR32Sint)
     , mDevice(device)
     , mSize(size)
-    , mParticles(particles)
-    , mNewParticles(device, 8 * size.x * size.y)
-    , mDelta(device, size.x * size.y)
-    , mCount(device, size.x * size.y)
-    , mIndex(device, size.x * size.y)
-    , mSeeds(device, 4, VMA_MEMORY_USAGE_CPU_TO_GPU)
+    , mNewParticles(device,
+                    vk::BufferUsageFlagBits::eStorageBuffer |
+                        vk::BufferUsageFlagBits::eVertexBuffer,
+                    VMA_MEMORY_USAGE_GPU_ONLY,
+                    particles.Size())
+    , mParticles{&particles, &mNewParticles}
+    , mCurrent(0)
+    , mDelta(device, CellsCount(size, cellOrder))
+    , mCount(device, CellsCount(size, cellOrder))
+    , mIndex(device, CellsCount(size, cellOrder))
+    , mSeeds(device, MaxParticlesPerCell, VMA_MEMORY_USAGE_CPU_TO_GPU)
+    , mBucketCandidate(device, CellsCount(size, cellOrder))
+    , mBucketLast(device, CellsCount(size, cellOrder))
+    , mDeficit(device, CellsCount(size, cellOrder))
+    , mStats(device)
+    , mStatsReadback(device, mStats)
+    , mBand(device, CellsCount(size, cellOrder))
+    , mSpawnVelocity(device, size.x, size.y, vk::Format::eR32G32Sfloat)
     , mDispatchParams(device)
     , mLocalDispatchParams(device, 1, VMA_MEMORY_USAGE_CPU_ONLY)
     , mNewDispatchParams(device)
-    , mParticleCountWork(device, Renderer::ComputeSize::Default1D(), SPIRV::ParticleCount_comp)
-    , mParticleCountBound(mParticleCountWork.Bind(size, {particles, mDispatchParams, mDelta}))
-    , mParticleClampWork(device, size, SPIRV::ParticleClamp_comp)
-    , mParticleClampBound(mParticleClampWork.Bind(size, {mDelta}))
-    , mPrefixScan(device, size)
+    , mParticleCountWork(device,
+                         Renderer::ComputeSize::Default1D(),
+                         SPIRV::ParticleCount_comp,
+                         ParticleSpecConst(layout, transfer, cellOrder))
+    , mParticleClampWork(device,
+                         size,
+                         SPIRV::ParticleClamp_comp,
+                         Renderer::SpecConst(
+                             Renderer::SpecConstValue(6, static_cast<int>(cellOrder))))
+    , mParticleClampBound(mParticleClampWork.Bind(size, {mDelta, mDeficit, *this, mBand}))
+    , mParticleBandWork(device,
+                        size,
+                        SPIRV::ParticleBand_comp,
+                        Renderer::SpecConst(
+                            Renderer::SpecConstValue(6, static_cast<int>(cellOrder))))
+    , mParticleCapacityWork(device,
+                            size,
+                            SPIRV::ParticleCapacity_comp,
+                            ParticleSpecConst(layout, transfer, cellOrder))
+    , mPrefixScan(device, CellsSize(size, cellOrder))
     , mPrefixScanBound(mPrefixScan.Bind(mDelta, mIndex, mNewDispatchParams))
-    , mParticleBucketWork(device, Renderer::ComputeSize::Default1D(), SPIRV::ParticleBucket_comp)
-    , mParticleBucketBound(
-          mParticleBucketWork.Bind(size,
-                                   {particles, mNewParticles, mIndex, mDelta, mDispatchParams}))
-    , mParticleSpawnWork(device, size, SPIRV::ParticleSpawn_comp)
-    , mParticleSpawnBound(mParticleSpawnWork.Bind({mNewParticles, mIndex, mDelta, mSeeds}))
+    , mParticleBucketWork(device,
+                          Renderer::ComputeSize::Default1D(),
+                          SPIRV::ParticleBucket_comp,
+                          ParticleSpecConst(layout, transfer, cellOrder))
+    , mParticleBucketCandidateWork(device,
+                                   Renderer::ComputeSize::Default1D(),
+                                   SPIRV::ParticleBucketCandidate_comp,
+                                   ParticleSpecConst(layout, transfer, cellOrder))
+    , mParticleBucketSelectWork(device,
+                                size,
+                                SPIRV::ParticleBucketSelect_comp,
+                                ParticleSpecConst(layout, transfer, cellOrder))
+    , mParticleSpawnWork(device,
+                         size,
+                         SPIRV::ParticleSpawn_comp,
+                         ParticleSpecConst(layout, transfer, cellOrder))
     , mParticlePhiWork(device,
                        size,
                        SPIRV::ParticlePhi_comp,
-                       Renderer::SpecConst(Renderer::SpecConstValue(3, particleSize)))
-    , mParticleToGridWork(device, size, SPIRV::ParticleToGrid_comp)
+                       Renderer::SpecConst(
+                           Renderer::SpecConstValue(3, particleSize),
+                           Renderer::SpecConstValue(4, static_cast<int>(layout)),
+                           Renderer::SpecConstValue(5, static_cast<int>(transfer)),
+                           Renderer::SpecConstValue(6, static_cast<int>(cellOrder)),
+                           Renderer::SpecConstValue(7, static_cast<int>(phiMode))))
+    , mParticleToGridWork(device,
+                          toGridMode == ParticleToGridMode::Scatter
+                              ? Renderer::ComputeSize(size, ScatterTileSize)
+                              : Renderer::ComputeSize(size),
+                          toGridMode == ParticleToGridMode::Scatter
+                              ? VelocityShader(velocityPrecision,
+                                               SPIRV::ParticleToGridScatter_comp,
+                                               SPIRV::ParticleToGridScatterHalf_comp)
+                              : VelocityShader(velocityPrecision,
+                                               SPIRV::ParticleToGrid_comp,
+                                               SPIRV::ParticleToGridHalf_comp),
+                          ParticleSpecConst(layout, transfer, cellOrder))
     , mParticleFromGridWork(device,
                             Renderer::ComputeSize::Default1D(),
-                            SPIRV::ParticleFromGrid_comp,
-                            Renderer::SpecConst(Renderer::SpecConstValue(3, interpolationMode)))
-    , mScanWork(device, false)
-    , mDispatchCountWork(device)
-    , mParticlePhi(device, false)
-    , mParticleToGrid(device, false)
-    , mParticleFromGrid(device, false)
+                            VelocityShader(velocityPrecision,
+                                           SPIRV::ParticleFromGrid_comp,
+                                           SPIRV::ParticleFromGridHalf_comp),
+                            Renderer::SpecConst(
+                                Renderer::SpecConstValue(3, interpolationMode),
+                                Renderer::SpecConstValue(4, static_cast<int>(layout)),
+                                Renderer::SpecConstValue(5, static_cast<int>(transfer))))
+    , mLevelSet(nullptr)
+    , mBandLevelSet(nullptr)
+    , mBandWidth(0.0f)
+    , mVelocity(nullptr)
+    , mValid(nullptr)
     , mAlpha(alpha)
+    , mCapacity(particles.Size() / GetBytesPerParticle(layout, transfer))
+    , mLayout(layout)
+    , mToGridMode(toGridMode)
+    , mTransfer(transfer)
+    , mVelocityPrecision(velocityPrecision)
+    , mDeterministic(false)
+    , mGenerator(std::random_device()())
 {
+  if (mCapacity > static_cast<std::size_t>(MaxParticlesPerCell * size.x * size.y))
+  {
+    throw std::runtime_error("Particle buffer larger than the maximum number of particles");
+  }
+
+  if (layout == ParticleLayout::Compact && (size.x > MaxCompactSize || size.y > MaxCompactSize))
+  {
+    throw std::runtime_error("Grid too large for the compact particle layout");
+  }
+
   Renderer::CopyFrom(mLocalDispatchParams, params);
   device.Execute([&](vk::CommandBuffer commandBuffer) {
     mDispatchParams.CopyFrom(commandBuffer, mLocalDispatchParams);
+    mDeficit.Clear(commandBuffer);
+    mBand.Clear(commandBuffer);
+    mSpawnVelocity.Clear(commandBuffer, std::array<float, 4>{0.0f, 0.0f, 0.0f, 0.0f});
   });
 
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    mScanWork.emplace_back(device, false);
+    mParticlePhi.emplace_back(device, false);
+    mParticleToGrid.emplace_back(device, false);
+    mParticleFromGrid.emplace_back(device, false);
+  }
+
   // TODO clamp should be configurable
 
   // Algorithm
-  // 1) copy this to mDelta
+  // 1) clear mDelta, indexed by grid cell in the cell order
+  // 2) for each particle, increase count in grid cell mDelta
+  // 3) add this to mDelta and clamp grid cell of mDelta count between [0, 8]
   //    -> this sets the number of particles we want to add or remove in each
   //    grid cell
-  // 2) for each particle, increase count in grid cell mDelta
-  // 3) clamp grid cell of mDelta count between [0, 8]
   //    -> now mDelta contains the number of particles we want in each cell.
   //       which means deleting some or add some
   // 4) copy mDelta to mCount
@@ -90,61 +241,221 @@ ParticleCount::ParticleCount(const Renderer::Device& device,
   //    -> using the mIndex mapping to get the index in the new particles buffer
   // 7) for each grid cell mDelta > 0, add new particle in new particles
   //    -> set the new particles with random position
-  // 8) copy new particles to particles
+  // 8) swap the particles and new particles buffers
+
+  Bind();
+}
+
+void ParticleCount::Bind()
+{
+  // The particles are bucketed from one buffer to the other, so each step
+  // alternates between two sets of bindings instead of copying them back.
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    auto& src = *mParticles[i];
+    auto& dst = *mParticles[1 - i];
+
+    mParticleCountBound[i] = mParticleCountWork.Bind(mSize, {src, mDispatchParams, mDelta});
+    mParticleCapacityBound[i] = mParticleCapacityWork.Bind(
+        {dst, mIndex, mDelta, mCount, mDeficit, mNewDispatchParams, mStats});
+    mParticleBucketBound[i] =
+        mParticleBucketWork.Bind(mSize, {src, dst, mIndex, mDelta, mDispatchParams});
+    mParticleBucketCandidateBound[i] = mParticleBucketCandidateWork.Bind(
+        mSize, {src, mBucketCandidate, mBucketLast, mDispatchParams});
+    mParticleBucketSelectBound[i] = mParticleBucketSelectWork.Bind(
+        {src, dst, mIndex, mDelta, mBucketCandidate, mBucketLast});
+    mParticleSpawnBound[i] =
+        mParticleSpawnWork.Bind({dst, mIndex, mDelta, mSeeds, mBand, mSpawnVelocity});
+  }
+
+  RecordScan(0);
+  RecordScan(1);
+
+  if (mLevelSet)
+  {
+    RecordPhi();
+  }
 
-  mScanWork.Record([&](vk::CommandBuffer commandBuffer) {
+  if (mVelocity)
+  {
+    RecordVelocities();
+  }
+}
+
+void ParticleCount::RecordScan(std::size_t index)
+{
+  mScanWork[index].Record([&](vk::CommandBuffer commandBuffer) {
     commandBuffer.debugMarkerBeginEXT({"Particle count", {{0.14f, 0.39f, 0.12f, 1.0f}}},
                                       mDevice.Loader());
-    mDelta.CopyFrom(commandBuffer, *this);
-    Clear(commandBuffer, std::array<int, 4>{0, 0, 0, 0});
-    mParticleCountBound.RecordIndirect(commandBuffer, mDispatchParams);
+    if (mBandLevelSet)
+    {
+      mParticleBandBound.PushConstant(commandBuffer, mBandWidth);
+      mParticleBandBound.Record(commandBuffer);
+      mBand.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    }
+    mDelta.Clear(commandBuffer);
+    mParticleCountBound[index].RecordIndirect(commandBuffer, mDispatchParams);
     mDelta.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
     mParticleClampBound.Record(commandBuffer);
     mDelta.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    Clear(commandBuffer, std::array<int, 4>{0, 0, 0, 0});
     mCount.CopyFrom(commandBuffer, mDelta);
     commandBuffer.debugMarkerEndEXT(mDevice.Loader());
 
     commandBuffer.debugMarkerBeginEXT({"Particle scan", {{0.59f, 0.20f, 0.35f, 1.0f}}},
                                       mDevice.Loader());
     mPrefixScanBound.Record(commandBuffer);
-    mParticleBucketBound.RecordIndirect(commandBuffer, mDispatchParams);
-    mNewParticles.Barrier(
+    mStats.Clear(commandBuffer);
+    mParticleCapacityBound[index].Record(commandBuffer);
+    mDelta.Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    mCount.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    mParticleSpawnBound.Record(commandBuffer);
-    mNewParticles.Barrier(
+    mNewDispatchParams.Barrier(
         commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    particles.CopyFrom(commandBuffer, mNewParticles);
+    if (mDeterministic)
+    {
+      // Each pass buckets the particle with the lowest index in each cell
+      mBucketCandidate.Clear(commandBuffer);
+      mBucketLast.Clear(commandBuffer);
+      for (int i = 0; i < MaxParticlesPerCell; i++)
+      {
+        mParticleBucketCandidateBound[index].RecordIndirect(commandBuffer, mDispatchParams);
+        mBucketCandidate.Barrier(
+            commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+        mParticleBucketSelectBound[index].Record(commandBuffer);
+        mBucketCandidate.Barrier(
+            commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+        mBucketLast.Barrier(
+            commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+        mDelta.Barrier(
+            commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      }
+    }
+    else
+    {
+      mParticleBucketBound[index].RecordIndirect(commandBuffer, mDispatchParams);
+    }
+    mParticles[1 - index]->Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    mParticleSpawnBound[index].Record(commandBuffer);
+    mParticles[1 - index]->Barrier(
+        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    mSpawnVelocity.Clear(commandBuffer, std::array<float, 4>{0.0f, 0.0f, 0.0f, 0.0f});
     mDispatchParams.CopyFrom(commandBuffer, mNewDispatchParams);
     commandBuffer.debugMarkerEndEXT(mDevice.Loader());
   });
-
-  mDispatchCountWork.Record([&](vk::CommandBuffer commandBuffer) {
-    mLocalDispatchParams.CopyFrom(commandBuffer, mDispatchParams);
-  });
 }
 
 void ParticleCount::Scan()
 {
-  std::random_device rd;
-  std::mt19937 gen(rd());
   std::uniform_int_distribution<> dis;
 
-  std::vector<glm::ivec2> seeds = {
-      {dis(gen), dis(gen)}, {dis(gen), dis(gen)}, {dis(gen), dis(gen)}, {dis(gen), dis(gen)}};
+  std::vector<glm::ivec2> seeds(MaxParticlesPerCell);
+  for (auto& seed : seeds)
+  {
+    seed = {dis(mGenerator), dis(mGenerator)};
+  }
 
   Renderer::CopyFrom(mSeeds, seeds);
-  mScanWork.Submit();
+  mScanWork[mCurrent].Submit();
+  mStatsReadback.Submit();
+  mCurrent = 1 - mCurrent;
+}
+
+std::size_t ParticleCount::GetCapacity() const
+{
+  return mCapacity;
+}
+
+void ParticleCount::SetCapacity(std::size_t capacity)
+{
+  if (capacity > static_cast<std::size_t>(MaxParticlesPerCell * mSize.x * mSize.y))
+  {
+    throw std::runtime_error("Particle capacity larger than the maximum number of particles");
+  }
+
+  mDevice.Queue().waitIdle();
+  mCapacity = capacity;
+  for (auto* particles : mParticles)
+  {
+    particles->Resize(mCapacity * GetBytesPerParticle(mLayout, mTransfer));
+  }
+  Bind();
+}
+
+bool ParticleCount::Grow()
+{
+  // Read back from a previous scan
+  ParticleStats stats;
+  if (!GetStats(stats))
+  {
+    return false;
+  }
+
+  // Grow when over three quarters full, with room to not grow again soon
+  auto maxCapacity = static_cast<std::size_t>(MaxParticlesPerCell * mSize.x * mSize.y);
+  auto wanted = static_cast<std::size_t>(stats.Count + stats.Dropped);
+  if (mCapacity == maxCapacity || 4 * wanted <= 3 * mCapacity)
+  {
+    return false;
+  }
+
+  mCapacity = std::min(2 * wanted, maxCapacity);
+  auto bufferSize = mCapacity * GetBytesPerParticle(mLayout, mTransfer);
+
+  // Resize the buffer the particles are bucketed in, then the other one
+  mDevice.Queue().waitIdle();
+  mParticles[1 - mCurrent]->Resize(bufferSize);
+  Bind();
+  Scan();
+
+  mDevice.Queue().waitIdle();
+  mParticles[1 - mCurrent]->Resize(bufferSize);
+  Bind();
+
+  return true;
+}
+
+void ParticleCount::SetDeterministic(bool deterministic, uint32_t seed)
+{
+  if (deterministic && mToGridMode == ParticleToGridMode::Scatter)
+  {
+    throw std::runtime_error("Deterministic mode requires the gather particle to grid transfer");
+  }
+
+  mGenerator.seed(deterministic ? seed : std::random_device()());
+  if (deterministic != mDeterministic)
+  {
+    mDeterministic = deterministic;
+    mDevice.Queue().waitIdle();
+    RecordScan(0);
+    RecordScan(1);
+  }
 }
 
 int ParticleCount::GetTotalCount()
 {
-  mDispatchCountWork.Submit().Wait();
+  ParticleStats stats;
+  GetStats(stats);
+  return stats.Count;
+}
+
+bool ParticleCount::GetStats(ParticleStats& stats)
+{
+  ParticleStats latest;
+  if (!mStatsReadback.Get(latest))
+  {
+    return false;
+  }
 
-  Renderer::DispatchParams params(0);
-  Renderer::CopyTo(mLocalDispatchParams, params);
-  return params.count;
+  // The minimum is stored as the maximum of its difference to the largest count
+  latest.MinPerCell = latest.MaxPerCell > 0 ? MaxParticlesPerCell - latest.MinPerCell : 0;
+  stats = latest;
+  return true;
 }
 
 Renderer::IndirectBuffer<Renderer::DispatchParams>& ParticleCount::GetDispatchParams()
@@ -152,62 +463,157 @@ Renderer::IndirectBuffer<Renderer::DispatchParams>& ParticleCount::GetDispatchPa
   return mDispatchParams;
 }
 
+Renderer::GenericBuffer& ParticleCount::GetParticles()
+{
+  return *mParticles[mCurrent];
+}
+
+Renderer::GenericBuffer& ParticleCount::GetParticles(std::size_t index)
+{
+  return *mParticles.at(index);
+}
+
+std::size_t ParticleCount::GetParticlesIndex() const
+{
+  return mCurrent;
+}
+
+void ParticleCount::SetParticlesIndex(std::size_t index)
+{
+  if (index > 1)
+  {
+    throw std::runtime_error("Invalid particles buffer index");
+  }
+
+  mCurrent = index;
+}
+
+Renderer::Texture& ParticleCount::GetSpawnVelocity()
+{
+  return mSpawnVelocity;
+}
+
+ParticleLayout ParticleCount::GetLayout() const
+{
+  return mLayout;
+}
+
+ParticleTransfer ParticleCount::GetTransfer() const
+{
+  return mTransfer;
+}
+
 void ParticleCount::LevelSetBind(LevelSet& levelSet)
+{
+  mLevelSet = &levelSet;
+  RecordPhi();
+}
+
+void ParticleCount::RecordPhi()
 {
   // TODO should shrink wrap wholes and redistance
-  mParticlePhiBound = mParticlePhiWork.Bind({mCount, mParticles, mIndex, levelSet});
-  mParticlePhi.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Particle phi", {{0.86f, 0.72f, 0.29f, 1.0f}}},
-                                      mDevice.Loader());
-    levelSet.Clear(commandBuffer, std::array<float, 4>{3.0f, 0.0f, 0.0f, 0.0f});
-    mParticlePhiBound.Record(commandBuffer);
-    levelSet.Barrier(commandBuffer,
-                     vk::ImageLayout::eGeneral,
-                     vk::AccessFlagBits::eShaderWrite,
-                     vk::ImageLayout::eGeneral,
-                     vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  auto& levelSet = *mLevelSet;
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    mParticlePhiBound[i] =
+        mParticlePhiWork.Bind({mCount, *mParticles[i], mIndex, levelSet, mBand});
+    mParticlePhi[i].Record([&](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Particle phi", {{0.86f, 0.72f, 0.29f, 1.0f}}},
+                                        mDevice.Loader());
+      mParticlePhiBound[i].Record(commandBuffer);
+      levelSet.Barrier(commandBuffer,
+                       vk::ImageLayout::eGeneral,
+                       vk::AccessFlagBits::eShaderWrite,
+                       vk::ImageLayout::eGeneral,
+                       vk::AccessFlagBits::eShaderRead);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
+}
+
+void ParticleCount::NarrowBandBind(Renderer::Texture& levelSet, float width)
+{
+  mDevice.Queue().waitIdle();
+  mBandWidth = width;
+  if (width > 0.0f)
+  {
+    mBandLevelSet = &levelSet;
+    mParticleBandBound = mParticleBandWork.Bind({levelSet, mBand});
+  }
+  else
+  {
+    mBandLevelSet = nullptr;
+    mDevice.Execute([&](vk::CommandBuffer commandBuffer) { mBand.Clear(commandBuffer); });
+  }
+
+  RecordScan(0);
+  RecordScan(1);
 }
 
 void ParticleCount::Phi()
 {
-  mParticlePhi.Submit();
+  mParticlePhi[mCurrent].Submit();
 }
 
 void ParticleCount::VelocitiesBind(Velocity& velocity, Renderer::GenericBuffer& valid)
 {
-  mParticleToGridBound = mParticleToGridWork.Bind({mCount, mParticles, mIndex, velocity, valid});
-  mParticleToGrid.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Particle to grid", {{0.71f, 0.15f, 0.48f, 1.0f}}},
-                                      mDevice.Loader());
-    valid.Clear(commandBuffer);
-    mParticleToGridBound.Record(commandBuffer);
-    valid.Barrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  if (velocity.GetPrecision() != mVelocityPrecision)
+  {
+    throw std::runtime_error("Velocity precision different from the particles'");
+  }
 
-  mParticleFromGridBound =
-      mParticleFromGridWork.Bind({mParticles, mDispatchParams, velocity, velocity.D()});
-  mParticleFromGrid.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Particle from grid", {{0.35f, 0.11f, 0.87f, 1.0f}}},
-                                      mDevice.Loader());
-    mParticleFromGridBound.PushConstant(commandBuffer, mSize.x, mSize.y, mAlpha);
-    mParticleFromGridBound.RecordIndirect(commandBuffer, mDispatchParams);
-    mParticles.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  mVelocity = &velocity;
+  mValid = &valid;
+  RecordVelocities();
+}
+
+void ParticleCount::RecordVelocities()
+{
+  auto& velocity = *mVelocity;
+  auto& valid = *mValid;
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    auto& particles = *mParticles[i];
+
+    mParticleToGridBound[i] =
+        mParticleToGridWork.Bind({mCount, particles, mIndex, velocity, valid, mBand});
+    mParticleToGrid[i].Record([&](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Particle to grid", {{0.71f, 0.15f, 0.48f, 1.0f}}},
+                                        mDevice.Loader());
+      valid.Clear(commandBuffer);
+      mParticleToGridBound[i].Record(commandBuffer);
+      valid.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+
+    // APIC doesn't use the velocity difference
+    Renderer::Texture& dVelocity = mTransfer == ParticleTransfer::Apic ? velocity : velocity.D();
+    mParticleFromGridBound[i] =
+        mParticleFromGridWork.Bind({particles, mDispatchParams, velocity, dVelocity});
+    mParticleFromGrid[i].Record([&](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Particle from grid", {{0.35f, 0.11f, 0.87f, 1.0f}}},
+                                        mDevice.Loader());
+      mParticleFromGridBound[i].PushConstant(commandBuffer, mSize.x, mSize.y, mAlpha);
+      mParticleFromGridBound[i].RecordIndirect(commandBuffer, mDispatchParams);
+      particles.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
 }
 
 void ParticleCount::TransferToGrid()
 {
-  mParticleToGrid.Submit();
+  // The transfers are bound to the velocity field itself
+  mVelocity->Resolve();
+  mParticleToGrid[mCurrent].Submit();
 }
 
 void ParticleCount::TransferFromGrid()
 {
-  mParticleFromGrid.Submit();
+  mVelocity->Resolve();
+  mParticleFromGrid[mCurrent].Submit();
 }
 
 }  // namespace Fluid
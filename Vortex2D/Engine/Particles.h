@@ -9,8 +9,13 @@
 #include <Vortex2D/Engine/PrefixScan.h>
 #include <Vortex2D/Engine/Velocity.h>
 #include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/Readback.h>
 #include <Vortex2D/Renderer/RenderTexture.h>
 
+#include <array>
+#include <random>
+#include <vector>
+
 namespace Vortex2D
 {
 namespace Fluid
@@ -25,9 +30,146 @@ struct Particle
 
 VORTEX2D_API float DefaultParticleSize();
 
+/**
+ * @brief How the particles are stored in a particle buffer. Interleaved
+ * matches @ref Particle. The other layouts store all the positions first, then
+ * all the velocities, so kernels only reading the positions read less memory.
+ */
+enum class ParticleLayout
+{
+  /**
+   * @brief Position and velocity of each particle next to each other
+   */
+  Interleaved = 0,
+  /**
+   * @brief Positions then velocities, as 32 bit floats
+   */
+  Separate = 1,
+  /**
+   * @brief Positions then velocities, as 16 bit fixed point positions over
+   * the grid and 16 bit float velocities. Half the size of the other layouts.
+   * The position resolution is (size + 2) / 65536 cells, so grids are limited
+   * to 254 cells along each axis, for a resolution of 1/256 of a cell.
+   */
+  Compact = 2,
+};
+
+/**
+ * @brief How the particle velocities are transferred to the grid.
+ */
+enum class ParticleToGridMode
+{
+  /**
+   * @brief Each grid cell reads the particles of its 3x3 neighbouring cells
+   */
+  Gather,
+  /**
+   * @brief Each tile of the grid reads the particles in and around it once and
+   * accumulates their contributions in shared memory
+   */
+  Scatter,
+};
+
+/**
+ * @brief How the velocities are transferred between the particles and the
+ * grid.
+ */
+enum class ParticleTransfer
+{
+  /**
+   * @brief Blend of PIC and FLIP, see the alpha of @ref ParticleCount. FLIP
+   * needs the difference of the grid velocities before and after the pressure
+   * solve, see @ref Velocity::VelocityDiff
+   */
+  PicFlip = 0,
+  /**
+   * @brief Affine particle in cell: the particles store the gradient of the
+   * velocity, which is used in both transfers. Doesn't need the velocity
+   * difference and needs fewer particles per cell for the same quality. The
+   * grid velocity is always interpolated bilinearly, as the gradient and the
+   * particle to grid weights, whatever the interpolation mode.
+   */
+  Apic = 1,
+};
+
+/**
+ * @brief Statistics of a @ref ParticleCount::Scan
+ */
+struct ParticleStats
+{
+  /**
+   * @brief Number of particles
+   */
+  int Count = 0;
+  /**
+   * @brief Particles dropped because the buffers were full, spawned again by
+   * the next scan
+   */
+  int Dropped = 0;
+  /**
+   * @brief Minimum number of particles of the cells with particles
+   */
+  int MinPerCell = 0;
+  /**
+   * @brief Maximum number of particles of a cell
+   */
+  int MaxPerCell = 0;
+};
+
+/**
+ * @brief Order of the grid cells when bucketing the particles, which is the
+ * order of the particles in memory.
+ */
+enum class ParticleCellOrder
+{
+  /**
+   * @brief Cells in row major order
+   */
+  RowMajor = 0,
+  /**
+   * @brief Cells along a Morton (Z-order) curve in tiles of 16x16 cells, so
+   * particles close in memory are close in the grid. Improves the cache hits
+   * of the kernels reading the particles of neighbouring cells.
+   */
+  Morton = 1,
+};
+
+/**
+ * @brief How the level set is built from the particles, see @ref
+ * ParticleCount::Phi
+ */
+enum class ParticlePhiMode
+{
+  /**
+   * @brief Minimum of the distances to the particles in the 7x7 cells around
+   * each cell. Bumpy surface, which needs many iterations of @ref
+   * LevelSet::Reinitialise.
+   */
+  Minimum = 0,
+  /**
+   * @brief Distance to the weighted average of the particles in the 3x3 cells
+   * around each cell (Zhu and Bridson). Smooth surface, with an accurate
+   * distance near it, so a few iterations of @ref LevelSet::Reinitialise are
+   * enough. Reads fewer particles.
+   */
+  Average = 1,
+};
+
+/**
+ * @brief Gets the number of bytes per particle given the layout
+ * @param layout particle layout
+ * @param transfer particle transfer, APIC particles store an affine matrix
+ * @return bytes per particle
+ */
+VORTEX2D_API std::size_t GetBytesPerParticle(ParticleLayout layout,
+                                             ParticleTransfer transfer = ParticleTransfer::PicFlip);
+
 /**
  * @brief Container for particles used in the advection of the fluid simulation.
  * Also a level set that is built from the particles.
+ *
+ * The capacity of the particles starts at the size of the particle buffer and
+ * grows with @ref Grow, up to 8 particles per cell.
  */
 class ParticleCount : public Renderer::RenderTexture
 {
@@ -38,7 +180,13 @@ public:
                              Velocity::InterpolationMode interpolationMode,
                              const Renderer::DispatchParams& params = {0},
                              float alpha = 1.0f,
-                             float particleSize = DefaultParticleSize());
+                             float particleSize = DefaultParticleSize(),
+                             ParticleLayout layout = ParticleLayout::Interleaved,
+                             ParticleToGridMode toGridMode = ParticleToGridMode::Gather,
+                             ParticleTransfer transfer = ParticleTransfer::PicFlip,
+                             ParticleCellOrder cellOrder = ParticleCellOrder::RowMajor,
+                             ParticlePhiMode phiMode = ParticlePhiMode::Minimum,
+                             Velocity::Precision velocityPrecision = Velocity::Precision::Float);
 
   /**
    * @brief Count the number of particles and update the internal data
@@ -47,17 +195,108 @@ public:
   VORTEX2D_API void Scan();
 
   /**
-   * @brief Calculate the total number of particles and return it.
+   * @brief In deterministic mode, particles are spawned with seeds from a
+   * fixed seed and the particles are sorted in the grid cells in the same
+   * order regardless of the GPU scheduling. Slower, as the particles are
+   * bucketed one per cell at a time. Not supported with the scatter particle
+   * to grid transfer, whose float atomics depend on the GPU scheduling.
+   * @param deterministic enable or disable the deterministic mode
+   * @param seed seed of the particle spawning
+   */
+  VORTEX2D_API void SetDeterministic(bool deterministic, uint32_t seed = 0);
+
+  /**
+   * @brief Number of particles of the latest scan read back, see @ref
+   * GetStats. Doesn't wait.
    * @return
    */
   VORTEX2D_API int GetTotalCount();
 
+  /**
+   * @brief Statistics of the latest scan read back. Each @ref Scan copies its
+   * statistics to a ring of host buffers, which are read back a few scans
+   * later without waiting. Wait for the device to be idle to get the last
+   * scan.
+   * @param stats the statistics, unchanged if none was read back yet
+   * @return if statistics were read back
+   */
+  VORTEX2D_API bool GetStats(ParticleStats& stats);
+
   /**
    * @brief Calculate the dispatch parameters to use on the particle buffer
    * @return
    */
   VORTEX2D_API Renderer::IndirectBuffer<Renderer::DispatchParams>& GetDispatchParams();
 
+  /**
+   * @brief The particles are double buffered: each @ref Scan buckets the
+   * particles from the current buffer into the other one, which then becomes
+   * the current buffer.
+   * @return the buffer with the current particles
+   */
+  VORTEX2D_API Renderer::GenericBuffer& GetParticles();
+
+  /**
+   * @brief Get one of the two particle buffers.
+   * @param index 0 for the buffer given in the constructor, 1 for the internal
+   * one
+   * @return the particle buffer
+   */
+  VORTEX2D_API Renderer::GenericBuffer& GetParticles(std::size_t index);
+
+  /**
+   * @brief Index of the buffer with the current particles, see @ref
+   * GetParticles
+   */
+  VORTEX2D_API std::size_t GetParticlesIndex() const;
+
+  /**
+   * @brief Set which buffer has the current particles, e.g. after restoring
+   * both buffers.
+   * @param index 0 or 1
+   */
+  VORTEX2D_API void SetParticlesIndex(std::size_t index);
+
+  /**
+   * @brief Number of particles the buffers can hold. When a @ref Scan wants
+   * more, the particles past the capacity are dropped and spawned again in the
+   * next scan.
+   */
+  VORTEX2D_API std::size_t GetCapacity() const;
+
+  /**
+   * @brief Resize the particle buffers, discarding their particles, e.g. before
+   * restoring them. The bindings of the buffers must be updated.
+   * @param capacity number of particles
+   */
+  VORTEX2D_API void SetCapacity(std::size_t capacity);
+
+  /**
+   * @brief Grow the particle buffers if a previous @ref Scan wanted more
+   * particles than the capacity, or nearly. The count is read back without
+   * waiting for the last scan. Growing waits for the device to be idle and
+   * moves the particles to the new buffers with an extra scan. To call before
+   * @ref Scan.
+   * @return true if the buffers were resized, their bindings must be updated
+   */
+  VORTEX2D_API bool Grow();
+
+  /**
+   * @brief Velocity of the particles spawned by the next @ref Scan in each
+   * cell, 0 by default and cleared by each scan. Set by @ref ParticleEmitters.
+   */
+  VORTEX2D_API Renderer::Texture& GetSpawnVelocity();
+
+  /**
+   * @brief Layout of the particles in the buffers
+   */
+  VORTEX2D_API ParticleLayout GetLayout() const;
+
+  /**
+   * @brief Velocity transfer between the particles and the grid
+   */
+  VORTEX2D_API ParticleTransfer GetTransfer() const;
+
   /**
    * @brief Bind a solid level set, which will be used to interpolate the
    * particles out of.
@@ -65,6 +304,19 @@ public:
    */
   VORTEX2D_API void LevelSetBind(LevelSet& levelSet);
 
+  /**
+   * @brief Keep the particles only in a band inside the liquid surface. Deeper
+   * cells have no particles: their level set is kept from the previous @ref
+   * Phi and their velocity from the velocity field, which should be advected
+   * on the grid before @ref TransferToGrid. Empty cells entering the band are
+   * given new particles, which take the grid velocity in @ref
+   * TransferFromGrid.
+   * @param levelSet liquid level set of the previous step, usually the one
+   * bound with @ref LevelSetBind
+   * @param width width of the band in cells, 0 to keep particles everywhere
+   */
+  VORTEX2D_API void NarrowBandBind(Renderer::Texture& levelSet, float width);
+
   /**
    * @brief Calculate the level set from the particles.
    */
@@ -72,7 +324,7 @@ public:
 
   /**
    * @brief Bind the velocities, used for advection of the particles.
-   * @param velocity
+   * @param velocity must have the velocity precision of the constructor
    * @param valid
    */
   VORTEX2D_API void VelocitiesBind(Velocity& velocity, Renderer::GenericBuffer& valid);
@@ -88,41 +340,73 @@ public:
   VORTEX2D_API void TransferFromGrid();
 
 private:
+  void Bind();
+  void RecordScan(std::size_t index);
+  void RecordPhi();
+  void RecordVelocities();
+
   const Renderer::Device& mDevice;
   glm::ivec2 mSize;
-  Renderer::GenericBuffer& mParticles;
-  Renderer::Buffer<Particle> mNewParticles;
+  Renderer::GenericBuffer mNewParticles;
+  std::array<Renderer::GenericBuffer*, 2> mParticles;
+  std::size_t mCurrent;
   Renderer::Buffer<int> mDelta, mCount;
   Renderer::Buffer<int> mIndex;
   Renderer::Buffer<glm::ivec2> mSeeds;
+  Renderer::Buffer<int> mBucketCandidate, mBucketLast;
+  Renderer::Buffer<int> mDeficit;
+  Renderer::Buffer<ParticleStats> mStats;
+  Renderer::Readback mStatsReadback;
+  Renderer::Buffer<int> mBand;
+  Renderer::Texture mSpawnVelocity;
 
   Renderer::IndirectBuffer<Renderer::DispatchParams> mDispatchParams;
   Renderer::Buffer<Renderer::DispatchParams> mLocalDispatchParams, mNewDispatchParams;
 
   Renderer::Work mParticleCountWork;
-  Renderer::Work::Bound mParticleCountBound;
+  std::array<Renderer::Work::Bound, 2> mParticleCountBound;
   Renderer::Work mParticleClampWork;
   Renderer::Work::Bound mParticleClampBound;
+  Renderer::Work mParticleBandWork;
+  Renderer::Work::Bound mParticleBandBound;
+  Renderer::Work mParticleCapacityWork;
+  std::array<Renderer::Work::Bound, 2> mParticleCapacityBound;
   PrefixScan mPrefixScan;
   PrefixScan::Bound mPrefixScanBound;
   Renderer::Work mParticleBucketWork;
-  Renderer::Work::Bound mParticleBucketBound;
+  std::array<Renderer::Work::Bound, 2> mParticleBucketBound;
+  Renderer::Work mParticleBucketCandidateWork;
+  std::array<Renderer::Work::Bound, 2> mParticleBucketCandidateBound;
+  Renderer::Work mParticleBucketSelectWork;
+  std::array<Renderer::Work::Bound, 2> mParticleBucketSelectBound;
   Renderer::Work mParticleSpawnWork;
-  Renderer::Work::Bound mParticleSpawnBound;
+  std::array<Renderer::Work::Bound, 2> mParticleSpawnBound;
   Renderer::Work mParticlePhiWork;
-  Renderer::Work::Bound mParticlePhiBound;
+  std::array<Renderer::Work::Bound, 2> mParticlePhiBound;
   Renderer::Work mParticleToGridWork;
-  Renderer::Work::Bound mParticleToGridBound;
+  std::array<Renderer::Work::Bound, 2> mParticleToGridBound;
   Renderer::Work mParticleFromGridWork;
-  Renderer::Work::Bound mParticleFromGridBound;
+  std::array<Renderer::Work::Bound, 2> mParticleFromGridBound;
+
+  std::vector<Renderer::CommandBuffer> mScanWork;
+  std::vector<Renderer::CommandBuffer> mParticlePhi;
+  std::vector<Renderer::CommandBuffer> mParticleToGrid;
+  std::vector<Renderer::CommandBuffer> mParticleFromGrid;
 
-  Renderer::CommandBuffer mScanWork;
-  Renderer::CommandBuffer mDispatchCountWork;
-  Renderer::CommandBuffer mParticlePhi;
-  Renderer::CommandBuffer mParticleToGrid;
-  Renderer::CommandBuffer mParticleFromGrid;
+  LevelSet* mLevelSet;
+  Renderer::Texture* mBandLevelSet;
+  float mBandWidth;
+  Velocity* mVelocity;
+  Renderer::GenericBuffer* mValid;
 
   float mAlpha;
+  std::size_t mCapacity;
+  ParticleLayout mLayout;
+  ParticleToGridMode mToGridMode;
+  ParticleTransfer mTransfer;
+  Velocity::Precision mVelocityPrecision;
+  bool mDeterministic;
+  std::mt19937 mGenerator;
 };
 
 }  // namespace Fluid
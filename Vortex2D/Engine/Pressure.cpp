@@ -23,40 +23,60 @@ Pressure::Pressure(const Renderer::Device& device,
                    Renderer::GenericBuffer& valid)
     : mDevice(device)
     , mData(data)
+    , mVelocity(velocity)
     , mBuildMatrix(device, size, SPIRV::BuildMatrix_comp)
     , mBuildMatrixBound(mBuildMatrix.Bind({data.Diagonal, data.Lower, liquidPhi, solidPhi}))
-    , mBuildDiv(device, size, SPIRV::BuildDiv_comp)
-    , mBuildDivBound(mBuildDiv.Bind({data.B, data.Diagonal, liquidPhi, solidPhi, velocity}))
-    , mProject(device, size, SPIRV::Project_comp)
-    , mProjectBound(
-          mProject.Bind({data.X, liquidPhi, solidPhi, velocity, velocity.Output(), valid}))
-    , mBuildEquationCmd(device, false)
-    , mProjectCmd(device, false)
+    , mBuildDiv(device,
+                size,
+                VelocityShader(
+                    velocity.GetPrecision(), SPIRV::BuildDiv_comp, SPIRV::BuildDivHalf_comp))
+    , mProject(device,
+               size,
+               VelocityShader(
+                   velocity.GetPrecision(), SPIRV::Project_comp, SPIRV::ProjectHalf_comp))
 {
-  mBuildEquationCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Build equations", {{0.02f, 0.68f, 0.84f, 1.0f}}},
-                                      mDevice.Loader());
-    mBuildMatrixBound.PushConstant(commandBuffer, dt);
-    mBuildMatrixBound.Record(commandBuffer);
-    data.Diagonal.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    data.Lower.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    mBuildDivBound.Record(commandBuffer);
-    data.B.Barrier(
-        commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  // A command buffer for each front field of the velocity, the projection
+  // writes the back field
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    auto& front = velocity.Field(i);
+    auto& back = velocity.Field(1 - i);
+    mBuildDivBound[i] = mBuildDiv.Bind({data.B, data.Diagonal, liquidPhi, solidPhi, front});
+    mProjectBound[i] = mProject.Bind({data.X, liquidPhi, solidPhi, front, back, valid});
 
-  mProjectCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Pressure", {{0.45f, 0.47f, 0.75f, 1.0f}}},
-                                      mDevice.Loader());
-    valid.Clear(commandBuffer);
-    mProjectBound.PushConstant(commandBuffer, dt);
-    mProjectBound.Record(commandBuffer);
-    velocity.CopyBack(commandBuffer);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+    mBuildEquationCmd.emplace_back(device, false);
+    mBuildEquationCmd[i].Record([&, i](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Build equations", {{0.02f, 0.68f, 0.84f, 1.0f}}},
+                                        mDevice.Loader());
+      mBuildMatrixBound.PushConstant(commandBuffer, dt);
+      mBuildMatrixBound.Record(commandBuffer);
+      data.Diagonal.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      data.Lower.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      mBuildDivBound[i].Record(commandBuffer);
+      data.B.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+
+    mProjectCmd.emplace_back(device, false);
+    mProjectCmd[i].Record([&, i](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Pressure", {{0.45f, 0.47f, 0.75f, 1.0f}}},
+                                        mDevice.Loader());
+      valid.Clear(commandBuffer);
+      mProjectBound[i].PushConstant(commandBuffer, dt);
+      mProjectBound[i].Record(commandBuffer);
+      back.Barrier(commandBuffer,
+                   vk::ImageLayout::eGeneral,
+                   vk::AccessFlagBits::eShaderWrite,
+                   vk::ImageLayout::eGeneral,
+                   vk::AccessFlagBits::eShaderRead);
+      valid.Barrier(
+          commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
 }
 
 Renderer::Work::Bound Pressure::BindMatrixBuild(const glm::ivec2& size,
@@ -70,12 +90,13 @@ Renderer::Work::Bound Pressure::BindMatrixBuild(const glm::ivec2& size,
 
 void Pressure::BuildLinearEquation()
 {
-  mBuildEquationCmd.Submit();
+  mBuildEquationCmd[mVelocity.Front()].Submit();
 }
 
 void Pressure::ApplyPressure()
 {
-  mProjectCmd.Submit();
+  mProjectCmd[mVelocity.Front()].Submit();
+  mVelocity.Swap();
 }
 
 }  // namespace Fluid
@@ -14,6 +14,9 @@
 #include <Vortex2D/Renderer/Texture.h>
 #include <Vortex2D/Renderer/Work.h>
 
+#include <array>
+#include <vector>
+
 namespace Vortex2D
 {
 namespace Fluid
@@ -56,21 +59,23 @@ public:
 
   /**
    * @brief Apply the solution of the equation Ax = b, i.e. the pressure to the
-   * velocity to make it non-divergent.
+   * velocity to make it non-divergent. The result is written to the back field
+   * of the velocity, which is then swapped with the front one.
    */
   VORTEX2D_API void ApplyPressure();
 
 private:
   const Renderer::Device& mDevice;
   LinearSolver::Data& mData;
+  Velocity& mVelocity;
   Renderer::Work mBuildMatrix;
   Renderer::Work::Bound mBuildMatrixBound;
   Renderer::Work mBuildDiv;
-  Renderer::Work::Bound mBuildDivBound;
+  std::array<Renderer::Work::Bound, 2> mBuildDivBound;
   Renderer::Work mProject;
-  Renderer::Work::Bound mProjectBound;
-  Renderer::CommandBuffer mBuildEquationCmd;
-  Renderer::CommandBuffer mProjectCmd;
+  std::array<Renderer::Work::Bound, 2> mProjectBound;
+  std::vector<Renderer::CommandBuffer> mBuildEquationCmd;
+  std::vector<Renderer::CommandBuffer> mProjectCmd;
 };
 
 }  // namespace Fluid
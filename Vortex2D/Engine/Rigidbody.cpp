@@ -33,14 +33,13 @@ RigidBody::RigidBody(const Renderer::Device& device,
     , mLocalVelocity(device, VMA_MEMORY_USAGE_CPU_ONLY)
     , mClear({1000.0f, 0.0f, 0.0f, 0.0f})
     , mDiv(device, size, SPIRV::BuildRigidbodyDiv_comp)
-    , mConstrain(device, size, SPIRV::ConstrainRigidbodyVelocity_comp)
     , mForceWork(device, size, SPIRV::RigidbodyForce_comp)
     , mPressureWork(device, size, SPIRV::RigidbodyPressure_comp)
     , mDivCmd(device, false)
-    , mConstrainCmd(device, false)
     , mForceCmd(device, true)
     , mPressureCmd(device, false)
     , mVelocityCmd(device, false)
+    , mFluidVelocity(nullptr)
     , mSum(device, size)
     , mType(type)
     , mMass(0.0f)
@@ -48,6 +47,9 @@ RigidBody::RigidBody(const Renderer::Device& device,
 {
   mLocalPhiRender = mPhi.Record({mClear, drawable}, UnionBlend);
 
+  mConstrainCmd.emplace_back(device, false);
+  mConstrainCmd.emplace_back(device, false);
+
   mVelocityCmd.Record(
       [&](vk::CommandBuffer commandBuffer) { mVelocity.CopyFrom(commandBuffer, mLocalVelocity); });
 
@@ -118,14 +120,37 @@ void RigidBody::BindDiv(Renderer::GenericBuffer& div, Renderer::GenericBuffer& d
 
 void RigidBody::BindVelocityConstrain(Fluid::Velocity& velocity)
 {
-  mConstrainBound = mConstrain.Bind({velocity, velocity.Output(), mPhi, mVelocity, mCenter});
-  mConstrainCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Rigidbody constrain", {{0.29f, 0.36f, 0.21f, 1.0f}}},
-                                      mDevice.Loader());
-    mConstrainBound.Record(commandBuffer);
-    velocity.CopyBack(commandBuffer);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+  // The shader is created for the precision of the velocity
+  for (auto& constrainCmd : mConstrainCmd)
+  {
+    constrainCmd.Wait();
+  }
+
+  mConstrain = std::make_unique<Renderer::Work>(
+      mDevice,
+      glm::ivec2(mPhi.GetWidth(), mPhi.GetHeight()),
+      VelocityShader(velocity.GetPrecision(),
+                     SPIRV::ConstrainRigidbodyVelocity_comp,
+                     SPIRV::ConstrainRigidbodyVelocityHalf_comp));
+  mFluidVelocity = &velocity;
+
+  // The constrained velocity is written to the back field
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    auto& back = velocity.Field(1 - i);
+    mConstrainBound[i] = mConstrain->Bind({velocity.Field(i), back, mPhi, mVelocity, mCenter});
+    mConstrainCmd[i].Record([&, i](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Rigidbody constrain", {{0.29f, 0.36f, 0.21f, 1.0f}}},
+                                        mDevice.Loader());
+      mConstrainBound[i].Record(commandBuffer);
+      back.Barrier(commandBuffer,
+                   vk::ImageLayout::eGeneral,
+                   vk::AccessFlagBits::eShaderWrite,
+                   vk::ImageLayout::eGeneral,
+                   vk::AccessFlagBits::eShaderRead);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
 }
 
 void RigidBody::BindForce(Renderer::GenericBuffer& diagonal, Renderer::GenericBuffer& pressure)
@@ -193,9 +218,10 @@ void RigidBody::Pressure()
 
 void RigidBody::VelocityConstrain()
 {
-  if (mType & RigidBody::Type::eStatic)
+  if ((mType & RigidBody::Type::eStatic) && mFluidVelocity)
   {
-    mConstrainCmd.Submit();
+    mConstrainCmd[mFluidVelocity->Front()].Submit();
+    mFluidVelocity->Swap();
   }
 }
 
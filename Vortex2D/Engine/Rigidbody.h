@@ -17,6 +17,10 @@
 #include <Vortex2D/Renderer/Transformable.h>
 #include <Vortex2D/Renderer/Work.h>
 
+#include <array>
+#include <memory>
+#include <vector>
+
 namespace Vortex2D
 {
 namespace Fluid
@@ -154,7 +158,9 @@ public:
   VORTEX2D_API void Pressure();
 
   /**
-   * @brief Constrain the velocities field based on the body's velocity.
+   * @brief Constrain the velocities field based on the body's velocity. The
+   * result is written to the back field of the velocity, which is then swapped
+   * with the front one.
    */
   VORTEX2D_API void VelocityConstrain();
 
@@ -196,10 +202,13 @@ private:
   Renderer::Clear mClear;
   Renderer::RenderCommand mLocalPhiRender, mPhiRender;
 
-  Renderer::Work mDiv, mConstrain, mForceWork, mPressureWork;
-  Renderer::Work::Bound mDivBound, mConstrainBound, mForceBound, mPressureForceBound,
-      mPressureBound;
-  Renderer::CommandBuffer mDivCmd, mConstrainCmd, mForceCmd, mPressureCmd, mVelocityCmd;
+  Renderer::Work mDiv, mForceWork, mPressureWork;
+  std::unique_ptr<Renderer::Work> mConstrain;
+  Renderer::Work::Bound mDivBound, mForceBound, mPressureForceBound, mPressureBound;
+  Renderer::CommandBuffer mDivCmd, mForceCmd, mPressureCmd, mVelocityCmd;
+  std::array<Renderer::Work::Bound, 2> mConstrainBound;
+  std::vector<Renderer::CommandBuffer> mConstrainCmd;
+  Fluid::Velocity* mFluidVelocity;
   ReduceJ mSum;
   ReduceSum::Bound mLocalSumBound, mSumBound;
 
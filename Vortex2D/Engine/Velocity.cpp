@@ -5,37 +5,90 @@
 
 #include "Velocity.h"
 
+#include <stdexcept>
+
 #include "vortex2d_generated_spirv.h"
 
 namespace Vortex2D
 {
 namespace Fluid
 {
-Velocity::Velocity(const Renderer::Device& device, const glm::ivec2& size)
-    : Renderer::RenderTexture(device, size.x, size.y, vk::Format::eR32G32Sfloat)
+namespace
+{
+vk::Format GetVelocityFormat(const Renderer::Device& device, Velocity::Precision precision)
+{
+  if (precision == Velocity::Precision::Float)
+  {
+    return vk::Format::eR32G32Sfloat;
+  }
+
+  // Storage of RG16 float images is optional
+  auto format = vk::Format::eR16G16Sfloat;
+  auto properties = device.GetPhysicalDevice().getFormatProperties(format);
+  if (!(properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage))
+  {
+    throw std::runtime_error("Half precision velocity is not supported by the device");
+  }
+
+  return format;
+}
+}  // namespace
+
+Velocity::Velocity(const Renderer::Device& device,
+                   const glm::ivec2& size,
+                   bool difference,
+                   Precision precision)
+    : Renderer::RenderTexture(device, size.x, size.y, GetVelocityFormat(device, precision))
     , mDevice(device)
-    , mOutputVelocity(device, size.x, size.y, vk::Format::eR32G32Sfloat)
-    , mDVelocity(device, size.x, size.y, vk::Format::eR32G32Sfloat)
-    , mVelocityDiff(device, size, SPIRV::VelocityDifference_comp)
-    , mVelocityDiffBound(mVelocityDiff.Bind({mDVelocity, *this, mOutputVelocity}))
-    , mSaveCopyCmd(device, false)
-    , mVelocityDiffCmd(device, false)
-{
-  mSaveCopyCmd.Record(
-      [&](vk::CommandBuffer commandBuffer) { mDVelocity.CopyFrom(commandBuffer, *this); });
-
-  mVelocityDiffCmd.Record([&](vk::CommandBuffer commandBuffer) {
-    commandBuffer.debugMarkerBeginEXT({"Velocity diff", {{0.32f, 0.60f, 0.67f, 1.0f}}},
-                                      mDevice.Loader());
-    mVelocityDiffBound.Record(commandBuffer);
-    mOutputVelocity.Barrier(commandBuffer,
-                            vk::ImageLayout::eGeneral,
-                            vk::AccessFlagBits::eShaderWrite,
-                            vk::ImageLayout::eGeneral,
-                            vk::AccessFlagBits::eShaderRead);
-    mDVelocity.CopyFrom(commandBuffer, mOutputVelocity);
-    commandBuffer.debugMarkerEndEXT(mDevice.Loader());
-  });
+    , mPrecision(precision)
+    , mOutputVelocity(device, size.x, size.y, GetFormat())
+    , mFront(0)
+    , mVelocityDiff(device,
+                    size,
+                    VelocityShader(precision,
+                                   SPIRV::VelocityDifference_comp,
+                                   SPIRV::VelocityDifferenceHalf_comp))
+    , mResolveCmd(device, false)
+{
+  mResolveCmd.Record([&](vk::CommandBuffer commandBuffer) { CopyBack(commandBuffer); });
+
+  if (!difference)
+  {
+    return;
+  }
+
+  mDVelocity = std::make_unique<Renderer::Texture>(device, size.x, size.y, GetFormat());
+
+  // The difference is computed in the back field, whichever it is
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    auto& front = Field(i);
+    auto& back = Field(1 - i);
+    mVelocityDiffBound[i] = mVelocityDiff.Bind({*mDVelocity, front, back});
+
+    mSaveCopyCmd.emplace_back(device, false);
+    mSaveCopyCmd[i].Record(
+        [&](vk::CommandBuffer commandBuffer) { mDVelocity->CopyFrom(commandBuffer, front); });
+
+    mVelocityDiffCmd.emplace_back(device, false);
+    mVelocityDiffCmd[i].Record([&, i](vk::CommandBuffer commandBuffer) {
+      commandBuffer.debugMarkerBeginEXT({"Velocity diff", {{0.32f, 0.60f, 0.67f, 1.0f}}},
+                                        mDevice.Loader());
+      mVelocityDiffBound[i].Record(commandBuffer);
+      back.Barrier(commandBuffer,
+                   vk::ImageLayout::eGeneral,
+                   vk::AccessFlagBits::eShaderWrite,
+                   vk::ImageLayout::eGeneral,
+                   vk::AccessFlagBits::eShaderRead);
+      mDVelocity->CopyFrom(commandBuffer, back);
+      commandBuffer.debugMarkerEndEXT(mDevice.Loader());
+    });
+  }
+}
+
+Velocity::Precision Velocity::GetPrecision() const
+{
+  return mPrecision;
 }
 
 Renderer::Texture& Velocity::Output()
@@ -45,7 +98,12 @@ Renderer::Texture& Velocity::Output()
 
 Renderer::Texture& Velocity::D()
 {
-  return mDVelocity;
+  if (!mDVelocity)
+  {
+    throw std::runtime_error("Velocity has no difference field");
+  }
+
+  return *mDVelocity;
 }
 
 void Velocity::CopyBack(vk::CommandBuffer commandBuffer)
@@ -53,6 +111,35 @@ void Velocity::CopyBack(vk::CommandBuffer commandBuffer)
   CopyFrom(commandBuffer, mOutputVelocity);
 }
 
+Renderer::Texture& Velocity::Field(std::size_t index)
+{
+  if (index == 0)
+  {
+    return *this;
+  }
+
+  return mOutputVelocity;
+}
+
+std::size_t Velocity::Front() const
+{
+  return mFront;
+}
+
+void Velocity::Swap()
+{
+  mFront = 1 - mFront;
+}
+
+void Velocity::Resolve()
+{
+  if (mFront == 1)
+  {
+    mResolveCmd.Submit();
+    mFront = 0;
+  }
+}
+
 void Velocity::Clear(vk::CommandBuffer commandBuffer)
 {
   RenderTexture::Clear(commandBuffer, std::array<float, 4>{0.0f, 0.0f, 0.0f, 0.0f});
@@ -60,12 +147,25 @@ void Velocity::Clear(vk::CommandBuffer commandBuffer)
 
 void Velocity::SaveCopy()
 {
-  mSaveCopyCmd.Submit();
+  if (!mSaveCopyCmd.empty())
+  {
+    mSaveCopyCmd[mFront].Submit();
+  }
 }
 
 void Velocity::VelocityDiff()
 {
-  mVelocityDiffCmd.Submit();
+  if (!mVelocityDiffCmd.empty())
+  {
+    mVelocityDiffCmd[mFront].Submit();
+  }
+}
+
+const Renderer::SpirvBinary& VelocityShader(Velocity::Precision precision,
+                                            const Renderer::SpirvBinary& floatShader,
+                                            const Renderer::SpirvBinary& halfShader)
+{
+  return precision == Velocity::Precision::Half ? halfShader : floatShader;
 }
 
 }  // namespace Fluid
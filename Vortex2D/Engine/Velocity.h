@@ -12,6 +12,10 @@
 #include <Vortex2D/Renderer/Texture.h>
 #include <Vortex2D/Renderer/Work.h>
 
+#include <array>
+#include <memory>
+#include <vector>
+
 namespace Vortex2D
 {
 namespace Fluid
@@ -20,6 +24,11 @@ namespace Fluid
  * @brief The Velocity field. Can be used to calculate a difference between
  * different states. Contains three fields: intput and output, used for
  * ping-pong algorithms, and d, the difference between two velocity fields.
+ *
+ * The input and output are double buffered: an algorithm writing a new velocity
+ * field records a command buffer for each of them as front, and swaps them
+ * instead of copying the output back. Everything binding this texture directly
+ * needs to @ref Resolve first.
  */
 class Velocity : public Renderer::RenderTexture
 {
@@ -33,7 +42,39 @@ public:
     Cubic = 1,
   };
 
-  VORTEX2D_API Velocity(const Renderer::Device& device, const glm::ivec2& size);
+  /**
+   * @brief Storage precision of the velocity fields. The shaders still compute
+   * in fp32.
+   */
+  enum class Precision : int
+  {
+    /**
+     * @brief RG32 float
+     */
+    Float = 0,
+    /**
+     * @brief RG16 float, half the memory and bandwidth. The device must
+     * support it as storage image.
+     */
+    Half = 1,
+  };
+
+  /**
+   * @brief Initialize the velocity field
+   * @param device vulkan device
+   * @param size size of the field
+   * @param difference if the difference field, see @ref D, is needed
+   * @param precision storage precision of the velocity fields
+   */
+  VORTEX2D_API Velocity(const Renderer::Device& device,
+                        const glm::ivec2& size,
+                        bool difference = true,
+                        Precision precision = Precision::Float);
+
+  /**
+   * @brief The storage precision of the velocity fields
+   */
+  VORTEX2D_API Precision GetPrecision() const;
 
   /**
    * @brief An output texture used for algorithms that used the velocity as
@@ -44,7 +85,8 @@ public:
 
   /**
    * @brief A difference velocity field, calculated with the difference between
-   * this velocity field, and the output velocity field
+   * this velocity field, and the output velocity field. Throws if the field
+   * was created without it.
    * @return
    */
   VORTEX2D_API Renderer::Texture& D();
@@ -55,6 +97,31 @@ public:
    */
   VORTEX2D_API void CopyBack(vk::CommandBuffer commandBuffer);
 
+  /**
+   * @brief One of the two velocity fields
+   * @param index 0 for this field, 1 for the output field
+   * @return the field
+   */
+  VORTEX2D_API Renderer::Texture& Field(std::size_t index);
+
+  /**
+   * @brief Index of the field, see @ref Field, with the current velocity. The
+   * other one is free to be written to.
+   * @return 0 or 1
+   */
+  VORTEX2D_API std::size_t Front() const;
+
+  /**
+   * @brief Swap the front and back fields, after the back one was written to.
+   */
+  VORTEX2D_API void Swap();
+
+  /**
+   * @brief Copy the output field to this field if it is the front, so this
+   * field has the current velocity.
+   */
+  VORTEX2D_API void Resolve();
+
   /**
    * @brief Clear the velocity field
    * @param commandBuffer
@@ -62,7 +129,8 @@ public:
   VORTEX2D_API void Clear(vk::CommandBuffer commandBuffer);
 
   /**
-   * @brief Copy to the difference field.
+   * @brief Copy to the difference field. Does nothing without a difference
+   * field.
    */
   VORTEX2D_API void SaveCopy();
 
@@ -74,16 +142,31 @@ public:
 
 private:
   const Renderer::Device& mDevice;
+  Precision mPrecision;
   Renderer::Texture mOutputVelocity;
-  Renderer::Texture mDVelocity;
+  std::unique_ptr<Renderer::Texture> mDVelocity;
+  std::size_t mFront;
 
   Renderer::Work mVelocityDiff;
-  Renderer::Work::Bound mVelocityDiffBound;
+  std::array<Renderer::Work::Bound, 2> mVelocityDiffBound;
 
-  Renderer::CommandBuffer mSaveCopyCmd;
-  Renderer::CommandBuffer mVelocityDiffCmd;
+  Renderer::CommandBuffer mResolveCmd;
+  std::vector<Renderer::CommandBuffer> mSaveCopyCmd;
+  std::vector<Renderer::CommandBuffer> mVelocityDiffCmd;
 };
 
+/**
+ * @brief Select the variant of a shader using the velocity, which declares the
+ * format of the velocity images.
+ * @param precision storage precision of the velocity
+ * @param floatShader shader for @ref Velocity::Precision::Float
+ * @param halfShader shader for @ref Velocity::Precision::Half
+ * @return the shader of the precision
+ */
+VORTEX2D_API const Renderer::SpirvBinary& VelocityShader(Velocity::Precision precision,
+                                                         const Renderer::SpirvBinary& floatShader,
+                                                         const Renderer::SpirvBinary& halfShader);
+
 }  // namespace Fluid
 }  // namespace Vortex2D
 
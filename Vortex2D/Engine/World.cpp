@@ -8,10 +8,20 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 namespace Vortex2D
 {
 namespace Fluid
 {
+namespace
+{
+// The averaged particles are close to a signed distance near the surface, so
+// the liquid level set only needs a thin band reinitialised
+const int LiquidPhiIterations = 10;
+}  // namespace
+
 template <typename Class>
 void ForAll(std::vector<Class*>& elements, void (Class::*f)())
 {
@@ -43,25 +53,35 @@ World::World(const Renderer::Device& device,
              const glm::ivec2& size,
              float dt,
              int numSubSteps,
-             Velocity::InterpolationMode interpolationMode)
+             Velocity::InterpolationMode interpolationMode,
+             Renderer::ResourcePool* resourcePool,
+             ParticleLayout particleLayout,
+             ParticleTransfer particleTransfer,
+             Velocity::Precision velocityPrecision)
     : mDevice(device)
     , mSize(size)
     , mDelta(dt / numSubSteps)
     , mNumSubSteps(numSubSteps)
     , mSolverSize(NextPowerOfTwo(size))
-    , mPreconditioner(device, mSolverSize, mDelta)
-    , mLinearSolver(device, mSolverSize, mPreconditioner)
+    , mPreconditioner(device,
+                      mSolverSize,
+                      mDelta,
+                      3,
+                      Multigrid::SmootherSolver::Jacobi,
+                      resourcePool)
+    , mLinearSolver(device, mSolverSize, mPreconditioner, resourcePool)
     , mData(device, mSolverSize)
 #if !defined(NDEBUG)
     , mDebugData(device, mSolverSize)
     , mDebugDataCopy(device, mSolverSize, mData, mDebugData)
 #endif
-    , mVelocity(device, size)
-    , mLiquidPhi(device, size)
-    , mStaticSolidPhi(device, size)
-    , mDynamicSolidPhi(device, size)
+    , mVelocity(device, size, particleTransfer == ParticleTransfer::PicFlip, velocityPrecision)
+    , mLiquidPhi(device, size, 50, resourcePool)
+    , mStaticSolidPhi(device, size, 50, resourcePool)
+    , mDynamicSolidPhi(device, size, 50, resourcePool)
     , mValid(device, size.x * size.y)
-    , mAdvection(device, size, mDelta, mVelocity, interpolationMode)
+    , mAdvection(
+          device, size, mDelta, mVelocity, interpolationMode, particleLayout, particleTransfer)
     , mProjection(device,
                   mDelta,
                   mSolverSize,
@@ -71,9 +91,15 @@ World::World(const Renderer::Device& device,
                   mLiquidPhi,
                   mValid)
     , mExtrapolation(device, size, mValid, mVelocity)
+    , mForces(device, size, mDelta, mVelocity)
     , mCopySolidPhi(device, false)
+    , mStaticSolidPhiVersion(0)
+    , mStaticSolidPhiDirty(true)
+    , mSolidPhiDirty(true)
     , mRigidBodySolver(nullptr)
     , mCfl(device, size, mVelocity)
+    , mCheckpointPending(false)
+    , mHashPending(false)
 {
   mExtrapolation.ConstrainBind(mDynamicSolidPhi);
   mLiquidPhi.ExtrapolateBind(mDynamicSolidPhi);
@@ -96,6 +122,22 @@ void World::Step(LinearSolver::Parameters& params)
   {
     Substep(params);
   }
+
+  // The velocity is double buffered during the step, it's bound and drawn to
+  // directly outside of it
+  mVelocity.Resolve();
+
+  if (mFieldHash)
+  {
+    // Read the previous step's hash while this step is running
+    if (mHashPending)
+    {
+      mStepHashes.push_back(mFieldHash->Get());
+    }
+
+    mFieldHash->Compute();
+    mHashPending = true;
+  }
 }
 
 Renderer::RenderCommand World::RecordVelocity(Renderer::RenderTarget::DrawableList drawables,
@@ -148,12 +190,55 @@ void World::AddRigidbody(RigidBody& rigidbody)
   rigidbody.BindForce(mData.Diagonal, mData.X);
 
   mRigidbodies.push_back(&rigidbody);
+  mSolidPhiDirty = true;
 }
 
 void World::RemoveRigidBody(RigidBody& rigidbody)
 {
   mRigidbodies.erase(std::remove(mRigidbodies.begin(), mRigidbodies.end(), &rigidbody),
                      mRigidbodies.end());
+  mSolidPhiDirty = true;
+}
+
+void World::UpdateSolidPhi()
+{
+  // The solid level set is only composed again when the static level set was
+  // drawn to, or a rigidbody was added, removed or moved.
+  bool staticChanged =
+      mStaticSolidPhiDirty || mStaticSolidPhi.GetVersion() != mStaticSolidPhiVersion;
+  bool changed = mSolidPhiDirty || staticChanged;
+  mRigidbodyTransforms.resize(mRigidbodies.size());
+  for (std::size_t i = 0; i < mRigidbodies.size(); i++)
+  {
+    mRigidbodies[i]->Update();
+    if (mRigidbodies[i]->GetTransform() != mRigidbodyTransforms[i])
+    {
+      mRigidbodyTransforms[i] = mRigidbodies[i]->GetTransform();
+      changed = true;
+    }
+  }
+
+  if (!changed)
+  {
+    return;
+  }
+
+  // The static level set is reinitialised in place and kept, so a moving
+  // rigidbody only pays for the copy and its own rendering. The rigidbodies
+  // draw signed distance fields, which are united with the reinitialised
+  // static level set without reinitialising the result.
+  if (staticChanged)
+  {
+    mStaticSolidPhi.Reinitialise();
+    mStaticSolidPhiDirty = false;
+    mStaticSolidPhiVersion = mStaticSolidPhi.GetVersion();
+  }
+
+  mSolidPhiDirty = false;
+
+  mCopySolidPhi.Submit();
+  ForAll(mRigidbodies, &RigidBody::RenderPhi);
+  ForAll(mRigidbodies, &RigidBody::UpdatePosition);
 }
 
 void World::AttachRigidBodySolver(RigidBodySolver& rigidbodySolver)
@@ -186,11 +271,164 @@ Renderer::Texture& World::GetVelocity()
   return mVelocity;
 }
 
+Renderer::Texture& World::GetLiquidPhi()
+{
+  return mLiquidPhi;
+}
+
+Renderer::Texture& World::GetSolidPhi()
+{
+  return mDynamicSolidPhi;
+}
+
+void World::SetAdvectionMode(AdvectionMode mode)
+{
+  mAdvection.SetMode(mode);
+}
+
+Forces& World::GetForces()
+{
+  return mForces;
+}
+
+void World::SetDeterministic(bool deterministic, uint32_t /*seed*/)
+{
+  if (mFieldHash)
+  {
+    GetStepHashes();
+  }
+
+  if (deterministic && !mFieldHash)
+  {
+    mFieldHash = std::make_unique<FieldHash>(
+        mDevice,
+        std::vector<std::reference_wrapper<Renderer::Texture>>{
+            mVelocity, mLiquidPhi, mDynamicSolidPhi});
+  }
+  else if (!deterministic)
+  {
+    mFieldHash.reset();
+  }
+
+  mStepHashes.clear();
+}
+
+const std::vector<uint32_t>& World::GetStepHashes()
+{
+  if (mHashPending)
+  {
+    mStepHashes.push_back(mFieldHash->Get());
+    mHashPending = false;
+  }
+
+  return mStepHashes;
+}
+
+void World::CheckpointBind(Checkpoint& checkpoint)
+{
+  checkpoint.Add("Velocity", mVelocity);
+  checkpoint.Add("LiquidPhi", mLiquidPhi);
+  checkpoint.Add("StaticSolidPhi", mStaticSolidPhi);
+  checkpoint.Add("DynamicSolidPhi", mDynamicSolidPhi);
+  checkpoint.Add("Valid", mValid);
+}
+
+Checkpoint& World::GetCheckpoint()
+{
+  if (!mCheckpoint)
+  {
+    mCheckpoint = std::make_unique<Checkpoint>(mDevice);
+    CheckpointBind(*mCheckpoint);
+  }
+
+  return *mCheckpoint;
+}
+
+void World::CheckpointSave(Checkpoint& checkpoint)
+{
+  // Rigidbody transforms: position, rotation and scale
+  std::vector<float> transforms;
+  for (auto* rigidbody : mRigidbodies)
+  {
+    transforms.insert(transforms.end(),
+                      {rigidbody->Position.x,
+                       rigidbody->Position.y,
+                       rigidbody->Rotation,
+                       rigidbody->Scale.x,
+                       rigidbody->Scale.y});
+  }
+
+  auto* bytes = reinterpret_cast<const uint8_t*>(transforms.data());
+  checkpoint.SetHostData("RigidBodies",
+                         std::vector<uint8_t>(bytes, bytes + transforms.size() * sizeof(float)));
+}
+
+void World::CheckpointLoad(const Checkpoint& checkpoint)
+{
+  auto& data = checkpoint.GetHostData("RigidBodies");
+  if (data.size() != mRigidbodies.size() * 5 * sizeof(float))
+  {
+    throw std::runtime_error("Checkpoint has a different number of rigidbodies");
+  }
+
+  auto* transforms = reinterpret_cast<const float*>(data.data());
+  for (auto* rigidbody : mRigidbodies)
+  {
+    rigidbody->Position = {transforms[0], transforms[1]};
+    rigidbody->Rotation = transforms[2];
+    rigidbody->Scale = {transforms[3], transforms[4]};
+    transforms += 5;
+  }
+}
+
+void World::DownloadCheckpoint()
+{
+  auto& checkpoint = GetCheckpoint();
+  CheckpointSave(checkpoint);
+  checkpoint.Download();
+  mCheckpointPending = true;
+}
+
+void World::SaveCheckpoint(const std::string& filename, bool compress)
+{
+  if (!mCheckpointPending)
+  {
+    DownloadCheckpoint();
+  }
+
+  mCheckpointPending = false;
+  GetCheckpoint().Write(filename, compress);
+}
+
+void World::LoadCheckpoint(const std::string& filename)
+{
+  auto& checkpoint = GetCheckpoint();
+  checkpoint.Read(filename);
+  CheckpointLoad(checkpoint);
+
+  mDevice.Handle().waitIdle();
+  checkpoint.Upload();
+  mStaticSolidPhiDirty = true;
+  mSolidPhiDirty = true;
+
+  mCheckpointPending = false;
+}
+
 SmokeWorld::SmokeWorld(const Renderer::Device& device,
                        const glm::ivec2& size,
                        float dt,
-                       Velocity::InterpolationMode interpolationMode)
-    : World(device, size, dt, 1, interpolationMode)
+                       Velocity::InterpolationMode interpolationMode,
+                       Renderer::ResourcePool* resourcePool,
+                       Velocity::Precision velocityPrecision)
+    : World(device,
+            size,
+            dt,
+            1,
+            interpolationMode,
+            resourcePool,
+            ParticleLayout::Interleaved,
+            ParticleTransfer::PicFlip,
+            velocityPrecision)
 {
 }
 
@@ -198,18 +436,19 @@ SmokeWorld::~SmokeWorld() {}
 
 void SmokeWorld::Substep(LinearSolver::Parameters& params)
 {
+  if (!mVelocities.empty())
+  {
+    mVelocity.Resolve();
+  }
+
   for (auto& velocity : mVelocities)
   {
     velocity->Submit();
   }
   mVelocities.clear();
+  mForces.Apply();
 
-  mCopySolidPhi.Submit();
-
-  ForAll(mRigidbodies, &RigidBody::RenderPhi);
-  ForAll(mRigidbodies, &RigidBody::UpdatePosition);
-
-  mDynamicSolidPhi.Reinitialise();
+  UpdateSolidPhi();
   mPreconditioner.BuildHierarchies();
   mProjection.BuildLinearEquation();
 
@@ -224,8 +463,7 @@ void SmokeWorld::Substep(LinearSolver::Parameters& params)
 
   ForAll(mRigidbodies, &RigidBody::Force);
 
-  mExtrapolation.Extrapolate();
-  mExtrapolation.ConstrainVelocity();
+  mExtrapolation.ExtrapolateConstrain();
 
   ForAll(mRigidbodies, &RigidBody::VelocityConstrain);
 
@@ -238,23 +476,63 @@ void SmokeWorld::Substep(LinearSolver::Parameters& params)
 void SmokeWorld::FieldBind(Density& density)
 {
   mAdvection.AdvectBind(density);
+  mDensities.push_back(&density);
+  mCheckpoint.reset();
+  mCheckpointPending = false;
+}
+
+void SmokeWorld::CheckpointBind(Checkpoint& checkpoint)
+{
+  World::CheckpointBind(checkpoint);
+  for (std::size_t i = 0; i < mDensities.size(); i++)
+  {
+    checkpoint.Add("Density" + std::to_string(i), *mDensities[i]);
+  }
 }
 
 WaterWorld::WaterWorld(const Renderer::Device& device,
                        const glm::ivec2& size,
                        float dt,
                        int numSubSteps,
-                       Velocity::InterpolationMode interpolationMode)
-    : World(device, size, dt, numSubSteps, interpolationMode)
+                       Velocity::InterpolationMode interpolationMode,
+                       Renderer::ResourcePool* resourcePool,
+                       ParticleLayout particleLayout,
+                       ParticleTransfer particleTransfer,
+                       Velocity::Precision velocityPrecision)
+    : World(device,
+            size,
+            dt,
+            numSubSteps,
+            interpolationMode,
+            resourcePool,
+            particleLayout,
+            particleTransfer,
+            velocityPrecision)
+    // Starts with one particle per cell, grown with the volume of liquid
     , mParticles(device,
                  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer,
                  VMA_MEMORY_USAGE_GPU_ONLY,
-                 8 * size.x * size.y * sizeof(Particle))
-    , mParticleCount(device, size, mParticles, interpolationMode, {0}, 0.02f)
+                 size.x * size.y * GetBytesPerParticle(particleLayout, particleTransfer))
+    , mParticleCount(device,
+                     size,
+                     mParticles,
+                     interpolationMode,
+                     {0},
+                     0.02f,
+                     DefaultParticleSize(),
+                     particleLayout,
+                     ParticleToGridMode::Gather,
+                     particleTransfer,
+                     ParticleCellOrder::RowMajor,
+                     ParticlePhiMode::Average,
+                     velocityPrecision)
+    , mEmitters(device, size, mParticleCount)
+    , mNarrowBand(0.0f)
 {
+  mLiquidPhi.SetReinitializeIterations(LiquidPhiIterations);
   mParticleCount.LevelSetBind(mLiquidPhi);
   mParticleCount.VelocitiesBind(mVelocity, mValid);
-  mAdvection.AdvectParticleBind(mParticles, mDynamicSolidPhi, mParticleCount.GetDispatchParams());
+  mAdvection.AdvectParticleBind(mParticleCount, mDynamicSolidPhi);
 }
 
 WaterWorld::~WaterWorld() {}
@@ -275,22 +553,34 @@ void WaterWorld::Substep(LinearSolver::Parameters& params)
   ParticlePhi();
 
   // 2)
+  // The interior of the narrow band has no particles and keeps the advected
+  // grid velocity
+  if (mNarrowBand > 0.0f)
+  {
+    mAdvection.AdvectVelocity();
+  }
   mParticleCount.TransferToGrid();
   mExtrapolation.Extrapolate();
-  mVelocity.SaveCopy();
+  if (mParticleCount.GetTransfer() == ParticleTransfer::PicFlip)
+  {
+    mVelocity.SaveCopy();
+  }
 
   // 3)
+  if (!mVelocities.empty())
+  {
+    mVelocity.Resolve();
+  }
+
   for (auto& velocity : mVelocities)
   {
     velocity->Submit();
   }
   mVelocities.clear();
+  mForces.Apply();
 
   // 4)
-  mCopySolidPhi.Submit();
-  ForAll(mRigidbodies, &RigidBody::RenderPhi);
-  ForAll(mRigidbodies, &RigidBody::UpdatePosition);
-  mDynamicSolidPhi.Reinitialise();
+  UpdateSolidPhi();
 
   ForAll(mRigidbodies, &RigidBody::Div);
 
@@ -308,13 +598,15 @@ void WaterWorld::Substep(LinearSolver::Parameters& params)
 
   ForAll(mRigidbodies, &RigidBody::Force);
 
-  mExtrapolation.Extrapolate();
-  mExtrapolation.ConstrainVelocity();
+  mExtrapolation.ExtrapolateConstrain();
 
   ForAll(mRigidbodies, &RigidBody::VelocityConstrain);
 
   // 6)
-  mVelocity.VelocityDiff();
+  if (mParticleCount.GetTransfer() == ParticleTransfer::PicFlip)
+  {
+    mVelocity.VelocityDiff();
+  }
   mParticleCount.TransferFromGrid();
 
   // 7)
@@ -330,8 +622,88 @@ Renderer::RenderCommand WaterWorld::RecordParticleCount(
   return mParticleCount.Record(drawables);
 }
 
+ParticleEmitters& WaterWorld::GetEmitters()
+{
+  return mEmitters;
+}
+
+void WaterWorld::SetNarrowBand(float width)
+{
+  if (width < 0.0f)
+  {
+    throw std::runtime_error("Negative narrow band width");
+  }
+
+  // The liquid level set is clamped at its reinitialised band, it must go
+  // deeper than the narrow band for the band to have an interior
+  int iterations = std::max(LiquidPhiIterations, static_cast<int>(std::ceil(width)) + 2);
+  mLiquidPhi.SetReinitializeIterations(iterations);
+
+  mNarrowBand = width;
+  mParticleCount.NarrowBandBind(mLiquidPhi, width);
+}
+
+void WaterWorld::SetParticleSubSteps(float cfl, int maxSubSteps)
+{
+  mAdvection.SetParticleSubSteps(cfl, maxSubSteps);
+}
+
+void WaterWorld::SetDeterministic(bool deterministic, uint32_t seed)
+{
+  World::SetDeterministic(deterministic, seed);
+  mParticleCount.SetDeterministic(deterministic, seed);
+}
+
+void WaterWorld::CheckpointBind(Checkpoint& checkpoint)
+{
+  World::CheckpointBind(checkpoint);
+  checkpoint.Add("Particles", mParticleCount.GetParticles(0), true);
+  checkpoint.Add("ParticlesBack", mParticleCount.GetParticles(1), true);
+  checkpoint.Add("ParticleCount", mParticleCount);
+  checkpoint.Add("ParticleDispatchParams", mParticleCount.GetDispatchParams());
+}
+
+void WaterWorld::CheckpointSave(Checkpoint& checkpoint)
+{
+  World::CheckpointSave(checkpoint);
+  checkpoint.SetHostData("ParticlesIndex",
+                         {static_cast<uint8_t>(mParticleCount.GetParticlesIndex())});
+}
+
+void WaterWorld::CheckpointLoad(const Checkpoint& checkpoint)
+{
+  auto& data = checkpoint.GetHostData("ParticlesIndex");
+  if (data.size() != 1 || data[0] > 1)
+  {
+    throw std::runtime_error("Checkpoint has an invalid particles index");
+  }
+
+  // The particle buffers have the capacity of the saved world
+  auto size = checkpoint.GetSize("Particles");
+  auto bytesPerParticle =
+      GetBytesPerParticle(mParticleCount.GetLayout(), mParticleCount.GetTransfer());
+  if (size != checkpoint.GetSize("ParticlesBack") || size % bytesPerParticle != 0)
+  {
+    throw std::runtime_error("Checkpoint has invalid particles");
+  }
+
+  World::CheckpointLoad(checkpoint);
+  mParticleCount.SetParticlesIndex(data[0]);
+  if (size / bytesPerParticle != mParticleCount.GetCapacity())
+  {
+    mParticleCount.SetCapacity(size / bytesPerParticle);
+    mAdvection.AdvectParticleBind(mParticleCount, mDynamicSolidPhi);
+  }
+}
+
 void WaterWorld::ParticlePhi()
 {
+  if (mParticleCount.Grow())
+  {
+    mAdvection.AdvectParticleBind(mParticleCount, mDynamicSolidPhi);
+  }
+
+  mEmitters.Emit();
   mParticleCount.Scan();
   mParticleCount.Phi();
   mLiquidPhi.Reinitialise();
@@ -13,8 +13,12 @@
 #include <Vortex2D/Engine/Advection.h>
 #include <Vortex2D/Engine/Boundaries.h>
 #include <Vortex2D/Engine/Cfl.h>
+#include <Vortex2D/Engine/Checkpoint.h>
 #include <Vortex2D/Engine/Density.h>
+#include <Vortex2D/Engine/Emitters.h>
 #include <Vortex2D/Engine/Extrapolation.h>
+#include <Vortex2D/Engine/FieldHash.h>
+#include <Vortex2D/Engine/Forces.h>
 #include <Vortex2D/Engine/LevelSet.h>
 #include <Vortex2D/Engine/LinearSolver/ConjugateGradient.h>
 #include <Vortex2D/Engine/LinearSolver/LinearSolver.h>
@@ -26,6 +30,7 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace Vortex2D
@@ -56,12 +61,25 @@ public:
    * @param dt timestamp of the simulation, e.g. 0.016 for 60FPS simulations.
    * @param numSubSteps the number of sub-steps to perform per step call.
    * Reduces loss of fluid.
+   * @param interpolationMode interpolation used for advection
+   * @param resourcePool optional pool to share temporary resources (solver,
+   * level set reinitialisation) with other worlds that are never stepped at the
+   * same time.
+   * @param particleLayout layout of the particles, for worlds with particles
+   * @param particleTransfer velocity transfer of the particles, for worlds with
+   * particles
+   * @param velocityPrecision storage precision of the velocity fields, half
+   * precision halves the velocity memory and bandwidth
    */
   World(const Renderer::Device& device,
         const glm::ivec2& size,
         float dt,
         int numSubSteps = 1,
-        Velocity::InterpolationMode interpolationMode = Velocity::InterpolationMode::Linear);
+        Velocity::InterpolationMode interpolationMode = Velocity::InterpolationMode::Linear,
+        Renderer::ResourcePool* resourcePool = nullptr,
+        ParticleLayout particleLayout = ParticleLayout::Interleaved,
+        ParticleTransfer particleTransfer = ParticleTransfer::PicFlip,
+        Velocity::Precision velocityPrecision = Velocity::Precision::Float);
   virtual ~World() = default;
 
   /**
@@ -89,7 +107,8 @@ public:
   /**
    * @brief Record drawables to the liquid level set, i.e. to define the fluid
    * area. The drawables need to make a signed distance field, if not the result
-   * is undefined.
+   * is undefined. The static solid level set is reinitialised once after it is
+   * drawn to and kept, rigidbodies are then united with it at every move.
    * @param drawables a list of signed distance field drawables
    * @return render command
    */
@@ -99,7 +118,8 @@ public:
   /**
    * @brief Record drawables to the solid level set, i.e. to define the boundary
    * area. The drawables need to make a signed distance field, if not the result
-   * is undefined.
+   * is undefined. The static solid level set is reinitialised once after it is
+   * drawn to and kept, rigidbodies are then united with it at every move.
    * @param drawables a list of signed distance field drawables
    * @return render command
    */
@@ -149,9 +169,83 @@ public:
    */
   VORTEX2D_API Renderer::Texture& GetVelocity();
 
+  /**
+   * @brief Get the liquid level set, can be used to read it back.
+   * @return liquid level set reference
+   */
+  VORTEX2D_API Renderer::Texture& GetLiquidPhi();
+
+  /**
+   * @brief Get the solid level set (static and rigidbodies), can be used to
+   * read it back.
+   * @return solid level set reference
+   */
+  VORTEX2D_API Renderer::Texture& GetSolidPhi();
+
+  /**
+   * @brief Start copying the world's state (velocity, level sets, particles,
+   * density fields and rigidbody transforms) to host memory. Doesn't wait for
+   * the copy to finish, so the simulation can keep being stepped until @ref
+   * SaveCheckpoint is called.
+   */
+  VORTEX2D_API void DownloadCheckpoint();
+
+  /**
+   * @brief Save the world's state to a file. Uses the state from the last
+   * @ref DownloadCheckpoint if there is one, otherwise the current state.
+   * @param filename path of the checkpoint file
+   * @param compress run-length compress the checkpoint
+   */
+  VORTEX2D_API void SaveCheckpoint(const std::string& filename, bool compress = false);
+
+  /**
+   * @brief Restore the world's state from a file saved by a world of the same
+   * type, size, bound fields and number of rigidbodies.
+   * @param filename path of the checkpoint file
+   */
+  VORTEX2D_API void LoadCheckpoint(const std::string& filename);
+
+  /**
+   * @brief Set the advection scheme of the velocity and density fields, e.g.
+   * MacCormack to keep more details at a lower resolution.
+   * @param mode the advection mode
+   */
+  VORTEX2D_API void SetAdvectionMode(AdvectionMode mode);
+
+  /**
+   * @brief Forces applied each sub-step after the velocities from
+   * @ref RecordVelocity, e.g. gravity, buoyancy or vorticity confinement. Use
+   * them instead of drawing the same forces to the velocity every step.
+   * @return the forces
+   */
+  VORTEX2D_API Forces& GetForces();
+
+  /**
+   * @brief Enable the deterministic mode: two runs with the same inputs give
+   * the same results. Particles are spawned from a fixed seed and bucketed in
+   * a fixed order. After each step, a hash of the velocity and level sets is
+   * computed on the GPU, see @ref GetStepHashes.
+   * @param deterministic enable or disable the deterministic mode
+   * @param seed seed used to spawn particles
+   */
+  VORTEX2D_API virtual void SetDeterministic(bool deterministic, uint32_t seed = 0);
+
+  /**
+   * @brief Get the hash of the fields after each step since the
+   * deterministic mode was enabled. Blocks until the last step's hash is
+   * computed.
+   * @return one hash per step
+   */
+  VORTEX2D_API const std::vector<uint32_t>& GetStepHashes();
+
 protected:
   void StepRigidBodies();
+  void UpdateSolidPhi();
   virtual void Substep(LinearSolver::Parameters& params) = 0;
+  virtual void CheckpointBind(Checkpoint& checkpoint);
+  virtual void CheckpointSave(Checkpoint& checkpoint);
+  virtual void CheckpointLoad(const Checkpoint& checkpoint);
+  Checkpoint& GetCheckpoint();
 
   const Renderer::Device& mDevice;
   glm::ivec2 mSize;
@@ -179,14 +273,26 @@ protected:
   Advection mAdvection;
   Pressure mProjection;
   Extrapolation mExtrapolation;
+  Forces mForces;
 
   Renderer::CommandBuffer mCopySolidPhi;
+  uint64_t mStaticSolidPhiVersion;
+  bool mStaticSolidPhiDirty;
+  std::vector<glm::mat4> mRigidbodyTransforms;
+  bool mSolidPhiDirty;
 
   std::vector<RigidBody*> mRigidbodies;
   RigidBodySolver* mRigidBodySolver;
   std::vector<Renderer::RenderCommand*> mVelocities;
 
   Cfl mCfl;
+
+  std::unique_ptr<Checkpoint> mCheckpoint;
+  bool mCheckpointPending;
+
+  std::unique_ptr<FieldHash> mFieldHash;
+  std::vector<uint32_t> mStepHashes;
+  bool mHashPending;
 };
 
 /**
@@ -199,17 +305,23 @@ public:
   VORTEX2D_API SmokeWorld(const Renderer::Device& device,
                           const glm::ivec2& size,
                           float dt,
-                          Velocity::InterpolationMode interpolationMode);
+                          Velocity::InterpolationMode interpolationMode,
+                          Renderer::ResourcePool* resourcePool = nullptr,
+                          Velocity::Precision velocityPrecision = Velocity::Precision::Float);
   VORTEX2D_API ~SmokeWorld() override;
 
   /**
-   * @brief Bind a density field to be moved around with the fluid
+   * @brief Bind a density field to be moved around with the fluid, e.g. dye,
+   * temperature or fuel. Multiple fields can be bound.
    * @param density the density field
    */
   VORTEX2D_API void FieldBind(Density& density);
 
 private:
   void Substep(LinearSolver::Parameters& params) override;
+  void CheckpointBind(Checkpoint& checkpoint) override;
+
+  std::vector<Density*> mDensities;
 };
 
 /**
@@ -218,11 +330,24 @@ private:
 class WaterWorld : public World
 {
 public:
+  /**
+   * @brief Construct a water world, see @ref World.
+   * @param particleLayout layout of the particles, the compact layout halves
+   * the particle memory and bandwidth at the cost of precision, for grids up
+   * to 254 cells along each axis
+   * @param particleTransfer velocity transfer between particles and grid, APIC
+   * can be used with fewer particles
+   * @param velocityPrecision storage precision of the velocity fields
+   */
   VORTEX2D_API WaterWorld(const Renderer::Device& device,
                           const glm::ivec2& size,
                           float dt,
                           int numSubSteps,
-                          Velocity::InterpolationMode interpolationMode);
+                          Velocity::InterpolationMode interpolationMode,
+                          Renderer::ResourcePool* resourcePool = nullptr,
+                          ParticleLayout particleLayout = ParticleLayout::Interleaved,
+                          ParticleTransfer particleTransfer = ParticleTransfer::PicFlip,
+                          Velocity::Precision velocityPrecision = Velocity::Precision::Float);
   VORTEX2D_API ~WaterWorld() override;
 
   /**
@@ -237,17 +362,49 @@ public:
   VORTEX2D_API Renderer::RenderCommand RecordParticleCount(
       Renderer::RenderTarget::DrawableList drawables);
 
+  /**
+   * @brief Sources and sinks of water, emitted at the start of each step. Use
+   * them instead of @ref RecordParticleCount to add or remove water every
+   * step.
+   * @return the emitters
+   */
+  VORTEX2D_API ParticleEmitters& GetEmitters();
+
   /**
    * @brief Using the particles, create a level set (phi) encompassing all the particles.
    * This can be viewed with @ref LiquidDistanceField
    */
   VORTEX2D_API void ParticlePhi();
 
+  /**
+   * @brief Only keep particles in a band inside the water surface, the deeper
+   * water is simulated on the grid. This reduces the number of particles for
+   * large volumes of water. The liquid level set is reinitialised at least
+   * two cells deeper than the band.
+   * @param width width of the band in cells, 0 to use particles everywhere
+   */
+  VORTEX2D_API void SetNarrowBand(float width);
+
+  /**
+   * @brief Sub-cycle the advection of each particle based on its velocity, so
+   * the grid can use fewer sub-steps, see @ref Advection::SetParticleSubSteps.
+   * @param cfl maximum number of cells moved per step, 0 to disable
+   * @param maxSubSteps maximum number of steps per particle
+   */
+  VORTEX2D_API void SetParticleSubSteps(float cfl, int maxSubSteps = 8);
+
+  VORTEX2D_API void SetDeterministic(bool deterministic, uint32_t seed = 0) override;
+
 private:
   void Substep(LinearSolver::Parameters& params) override;
+  void CheckpointBind(Checkpoint& checkpoint) override;
+  void CheckpointSave(Checkpoint& checkpoint) override;
+  void CheckpointLoad(const Checkpoint& checkpoint) override;
 
   Renderer::GenericBuffer mParticles;
   ParticleCount mParticleCount;
+  ParticleEmitters mEmitters;
+  float mNarrowBand;
 };
 
 }  // namespace Fluid
@@ -114,6 +114,16 @@ CommandBuffer& CommandBuffer::Wait()
   return *this;
 }
 
+bool CommandBuffer::Done() const
+{
+  if (mSynchronise)
+  {
+    return mDevice.Handle().getFenceStatus(*mFence) == vk::Result::eSuccess;
+  }
+
+  return true;
+}
+
 CommandBuffer& CommandBuffer::Reset()
 {
   if (mSynchronise)
@@ -67,6 +67,12 @@ public:
    */
   VORTEX2D_API CommandBuffer& Wait();
 
+  /**
+   * @brief Check if the command submit has finished, without waiting. Always
+   * true if the synchronise flag was false.
+   */
+  VORTEX2D_API bool Done() const;
+
   /**
    * @brief Reset the command buffer so it can be recorded again.
    */
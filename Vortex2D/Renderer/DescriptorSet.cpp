@@ -32,23 +32,35 @@ ShaderLayout::ShaderLayout(const SPIRV::Reflection& reflection)
 {
 }
 
-LayoutManager::LayoutManager(const Device& device) : mDevice(device) {}
+LayoutManager::LayoutManager(const Device& device) : mDevice(device), mDescriptorPoolSize(512) {}
 
 void LayoutManager::CreateDescriptorPool(int size)
+{
+  mDescriptorPoolSize = size;
+  mDescriptorPools.clear();
+  AddDescriptorPool();
+}
+
+void LayoutManager::AddDescriptorPool()
 {
   // create descriptor pool
   std::vector<vk::DescriptorPoolSize> poolSizes;
-  poolSizes.emplace_back(vk::DescriptorType::eUniformBuffer, size);
-  poolSizes.emplace_back(vk::DescriptorType::eCombinedImageSampler, size);
-  poolSizes.emplace_back(vk::DescriptorType::eStorageImage, size);
-  poolSizes.emplace_back(vk::DescriptorType::eStorageBuffer, size);
+  poolSizes.emplace_back(vk::DescriptorType::eUniformBuffer, mDescriptorPoolSize);
+  poolSizes.emplace_back(vk::DescriptorType::eCombinedImageSampler, mDescriptorPoolSize);
+  poolSizes.emplace_back(vk::DescriptorType::eStorageImage, mDescriptorPoolSize);
+  poolSizes.emplace_back(vk::DescriptorType::eStorageBuffer, mDescriptorPoolSize);
 
   vk::DescriptorPoolCreateInfo descriptorPoolInfo{};
   descriptorPoolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
-  descriptorPoolInfo.maxSets = 512;
+  descriptorPoolInfo.maxSets = mDescriptorPoolSize;
   descriptorPoolInfo.poolSizeCount = (uint32_t)poolSizes.size();
   descriptorPoolInfo.pPoolSizes = poolSizes.data();
-  mDescriptorPool = mDevice.Handle().createDescriptorPoolUnique(descriptorPoolInfo);
+  mDescriptorPools.push_back(mDevice.Handle().createDescriptorPoolUnique(descriptorPoolInfo));
+}
+
+std::size_t LayoutManager::GetDescriptorPoolCount() const
+{
+  return mDescriptorPools.size();
 }
 
 vk::DescriptorSetLayout LayoutManager::GetDescriptorSetLayout(const PipelineLayout& layout)
@@ -128,13 +140,37 @@ DescriptorSet LayoutManager::MakeDescriptorSet(const PipelineLayout& layout)
   vk::DescriptorSetLayout descriptorSetlayouts[] = {GetDescriptorSetLayout(layout)};
 
   auto descriptorSetInfo = vk::DescriptorSetAllocateInfo()
-                               .setDescriptorPool(*mDescriptorPool)
+                               .setDescriptorPool(*mDescriptorPools.back())
                                .setDescriptorSetCount(1)
                                .setPSetLayouts(descriptorSetlayouts);
 
+  auto allocate = [&] {
+    return std::move(mDevice.Handle().allocateDescriptorSetsUnique(descriptorSetInfo).at(0));
+  };
+
+  // Only a full or fragmented pool is recovered from, other errors are rethrown
   DescriptorSet descriptorSet;
-  descriptorSet.descriptorSet =
-      std::move(mDevice.Handle().allocateDescriptorSetsUnique(descriptorSetInfo).at(0));
+  bool poolFull = false;
+  try
+  {
+    descriptorSet.descriptorSet = allocate();
+  }
+  catch (const vk::OutOfPoolMemoryError&)
+  {
+    poolFull = true;
+  }
+  catch (const vk::FragmentedPoolError&)
+  {
+    poolFull = true;
+  }
+
+  if (poolFull)
+  {
+    // current pool is exhausted or fragmented, allocate from a new one
+    AddDescriptorPool();
+    descriptorSetInfo.setDescriptorPool(*mDescriptorPools.back());
+    descriptorSet.descriptorSet = allocate();
+  }
   descriptorSet.descriptorSetLayout = GetDescriptorSetLayout(layout);
   descriptorSet.pipelineLayout = GetPipelineLayout(layout);
 
@@ -69,11 +69,17 @@ public:
 
   /**
    * @brief Create or re-create the descriptor pool, will render invalid
-   * existing descriptor sets
+   * existing descriptor sets. When a pool is exhausted, a new one of the same
+   * size is added.
    * @param size size of the pool
    */
   void CreateDescriptorPool(int size = 512);
 
+  /**
+   * @brief The number of descriptor pools allocated so far.
+   */
+  VORTEX2D_API std::size_t GetDescriptorPoolCount() const;
+
   /**
    * @brief Create the descriptor set given the layout
    * @param layout pipeline/shader layout
@@ -97,8 +103,11 @@ public:
   VORTEX2D_API vk::PipelineLayout GetPipelineLayout(const PipelineLayout& layout);
 
 private:
+  void AddDescriptorPool();
+
   const Device& mDevice;
-  vk::UniqueDescriptorPool mDescriptorPool;
+  int mDescriptorPoolSize;
+  std::vector<vk::UniqueDescriptorPool> mDescriptorPools;
   std::vector<std::tuple<PipelineLayout, vk::UniqueDescriptorSetLayout>> mDescriptorSetLayouts;
   std::vector<std::tuple<PipelineLayout, vk::UniquePipelineLayout>> mPipelineLayouts;
 };
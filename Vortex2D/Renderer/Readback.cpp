@@ -0,0 +1,75 @@
+//
+//  Readback.cpp
+//  Vortex2D
+//
+
+#include "Readback.h"
+
+#include <Vortex2D/Renderer/Device.h>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+Readback::Readback(const Device& device, GenericBuffer& buffer, std::size_t size)
+    : mSubmitted(size, 0), mSubmitCount(0)
+{
+  if (size == 0)
+  {
+    throw std::runtime_error("Readback needs at least one buffer");
+  }
+
+  mBuffers.reserve(size);
+  mCopies.reserve(size);
+  for (std::size_t i = 0; i < size; i++)
+  {
+    mBuffers.emplace_back(device,
+                          vk::BufferUsageFlagBits::eStorageBuffer,
+                          VMA_MEMORY_USAGE_GPU_TO_CPU,
+                          buffer.Size());
+  }
+
+  for (std::size_t i = 0; i < size; i++)
+  {
+    mCopies.emplace_back(device, true);
+    mCopies.back().Record(
+        [&](vk::CommandBuffer commandBuffer) { mBuffers[i].CopyFrom(commandBuffer, buffer); });
+  }
+}
+
+void Readback::Submit()
+{
+  // The fence of a copy can't be reset while it is in flight, so wait for
+  // the copy a ring ago, which has usually completed
+  auto index = mSubmitCount % mCopies.size();
+  mCopies[index].Wait();
+  mCopies[index].Submit();
+  mSubmitted[index] = ++mSubmitCount;
+}
+
+void Readback::Wait()
+{
+  if (mSubmitCount > 0)
+  {
+    mCopies[(mSubmitCount - 1) % mCopies.size()].Wait();
+  }
+}
+
+GenericBuffer* Readback::Latest()
+{
+  GenericBuffer* latest = nullptr;
+  uint64_t latestSubmit = 0;
+  for (std::size_t i = 0; i < mCopies.size(); i++)
+  {
+    if (mSubmitted[i] > latestSubmit && mCopies[i].Done())
+    {
+      latest = &mBuffers[i];
+      latestSubmit = mSubmitted[i];
+    }
+  }
+
+  return latest;
+}
+
+}  // namespace Renderer
+}  // namespace Vortex2D
@@ -0,0 +1,84 @@
+//
+//  Readback.h
+//  Vortex2D
+//
+
+#ifndef Vortex2D_Readback_h
+#define Vortex2D_Readback_h
+
+#include <Vortex2D/Renderer/Buffer.h>
+#include <Vortex2D/Renderer/CommandBuffer.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+/**
+ * @brief Reads back a small buffer, e.g. statistics of a step, without
+ * stalling the GPU. Each @ref Submit copies the buffer to the next host
+ * buffer of a ring, after the work already submitted. @ref Get returns the
+ * most recent copy which has completed, usually from a few submits ago,
+ * without waiting on it.
+ */
+class Readback
+{
+public:
+  /**
+   * @brief Initialize the ring of host buffers
+   * @param device vulkan device
+   * @param buffer the buffer to read back
+   * @param size number of host buffers, i.e. of copies in flight
+   */
+  VORTEX2D_API Readback(const Device& device, GenericBuffer& buffer, std::size_t size = 3);
+
+  /**
+   * @brief Submit a copy of the buffer to the next host buffer. Only waits if
+   * the previous copy to that host buffer is still in flight.
+   */
+  VORTEX2D_API void Submit();
+
+  /**
+   * @brief Wait for the last @ref Submit to complete, so @ref Get returns it.
+   */
+  VORTEX2D_API void Wait();
+
+  /**
+   * @brief Get the most recent copy which has completed. Doesn't wait.
+   * @param value the copied value, unchanged if no copy has completed yet
+   * @return if a copy has completed
+   */
+  template <typename T>
+  bool Get(T& value)
+  {
+    auto* buffer = Latest();
+    if (!buffer)
+    {
+      return false;
+    }
+
+    if (sizeof(T) != buffer->Size())
+    {
+      throw std::runtime_error("Mismatch data size");
+    }
+
+    buffer->CopyTo(0, &value, sizeof(T));
+    return true;
+  }
+
+private:
+  VORTEX2D_API GenericBuffer* Latest();
+
+  std::vector<GenericBuffer> mBuffers;
+  std::vector<CommandBuffer> mCopies;
+  std::vector<uint64_t> mSubmitted;
+  uint64_t mSubmitCount;
+};
+
+}  // namespace Renderer
+}  // namespace Vortex2D
+
+#endif
@@ -0,0 +1,56 @@
+//
+//  ResourcePool.cpp
+//  Vortex2D
+//
+
+#include "ResourcePool.h"
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+ResourcePool::ResourcePool() {}
+
+std::size_t ResourcePool::Size() const
+{
+  return mResources.size();
+}
+
+std::shared_ptr<Texture> ResourcePool::AcquireTexture(const std::string& name,
+                                                      const Device& device,
+                                                      const glm::ivec2& size,
+                                                      vk::Format format)
+{
+  Key key(&device, name, size.x, size.y, format, std::type_index(typeid(Texture)));
+  auto it = mResources.find(key);
+  if (it != mResources.end())
+  {
+    return std::static_pointer_cast<Texture>(it->second);
+  }
+
+  auto texture = std::make_shared<Texture>(device, size.x, size.y, format);
+  mResources.emplace(key, texture);
+  return texture;
+}
+
+void ResourcePool::Clear()
+{
+  mResources.clear();
+}
+
+std::shared_ptr<Texture> AcquireTexture(ResourcePool* pool,
+                                        const std::string& name,
+                                        const Device& device,
+                                        const glm::ivec2& size,
+                                        vk::Format format)
+{
+  if (pool != nullptr)
+  {
+    return pool->AcquireTexture(name, device, size, format);
+  }
+
+  return std::make_shared<Texture>(device, size.x, size.y, format);
+}
+
+}  // namespace Renderer
+}  // namespace Vortex2D
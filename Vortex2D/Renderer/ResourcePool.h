@@ -0,0 +1,139 @@
+//
+//  ResourcePool.h
+//  Vortex2D
+//
+
+#ifndef Vortex2d_ResourcePool_h
+#define Vortex2d_ResourcePool_h
+
+#include <Vortex2D/Renderer/Common.h>
+#include <Vortex2D/Renderer/Texture.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <typeinfo>
+
+namespace Vortex2D
+{
+namespace Renderer
+{
+class Device;
+
+/**
+ * @brief A pool of scratch resources (buffers, textures, etc) shared between
+ * several objects. Resources are identified by their device, a name, a size,
+ * their type and, for textures, their format: acquiring the same resource twice
+ * returns the same instance. This allows multiple worlds on the same device to
+ * share their temporary buffers, as long as they are never stepped at the same
+ * time. Worlds on different devices get different resources.
+ */
+class ResourcePool
+{
+public:
+  VORTEX2D_API ResourcePool();
+
+  /**
+   * @brief Get a resource from the pool, creating it if it doesn't exist yet.
+   * @param name unique name of the resource
+   * @param device device the resource is created on, part of the resource key
+   * @param size size of the resource, part of the resource key
+   * @param args arguments to construct the resource with, after the device
+   * @return shared resource
+   */
+  template <typename T, typename... Args>
+  std::shared_ptr<T> Acquire(const std::string& name,
+                             const Device& device,
+                             const glm::ivec2& size,
+                             Args&&... args)
+  {
+    Key key(&device, name, size.x, size.y, vk::Format::eUndefined, std::type_index(typeid(T)));
+    auto it = mResources.find(key);
+    if (it != mResources.end())
+    {
+      return std::static_pointer_cast<T>(it->second);
+    }
+
+    auto resource = std::make_shared<T>(device, std::forward<Args>(args)...);
+    mResources.emplace(key, resource);
+    return resource;
+  }
+
+  /**
+   * @brief Get a device texture from the pool, creating it if it doesn't
+   * exist yet.
+   * @param name unique name of the texture
+   * @param device device the texture is created on
+   * @param size size of the texture
+   * @param format format of the texture, part of the resource key
+   * @return shared texture
+   */
+  VORTEX2D_API std::shared_ptr<Texture> AcquireTexture(const std::string& name,
+                                                       const Device& device,
+                                                       const glm::ivec2& size,
+                                                       vk::Format format);
+
+  /**
+   * @brief Number of resources in the pool.
+   */
+  VORTEX2D_API std::size_t Size() const;
+
+  /**
+   * @brief Release the pool's references. Resources still in use are kept
+   * alive by their users.
+   */
+  VORTEX2D_API void Clear();
+
+private:
+  using Key =
+      std::tuple<const Device*, std::string, int, int, vk::Format, std::type_index>;
+  std::map<Key, std::shared_ptr<void>> mResources;
+};
+
+/**
+ * @brief Get a resource from the pool if there is one, or create a resource
+ * owned by the caller.
+ * @param pool the resource pool, can be null
+ * @param name unique name of the resource
+ * @param device device the resource is created on
+ * @param size size of the resource
+ * @param args arguments to construct the resource with, after the device
+ * @return the resource
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> Acquire(ResourcePool* pool,
+                           const std::string& name,
+                           const Device& device,
+                           const glm::ivec2& size,
+                           Args&&... args)
+{
+  if (pool != nullptr)
+  {
+    return pool->Acquire<T>(name, device, size, std::forward<Args>(args)...);
+  }
+
+  return std::make_shared<T>(device, std::forward<Args>(args)...);
+}
+
+/**
+ * @brief Get a device texture from the pool if there is one, or create a
+ * texture owned by the caller.
+ * @param pool the resource pool, can be null
+ * @param name unique name of the texture
+ * @param device device the texture is created on
+ * @param size size of the texture
+ * @param format format of the texture
+ * @return the texture
+ */
+VORTEX2D_API std::shared_ptr<Texture> AcquireTexture(ResourcePool* pool,
+                                                     const std::string& name,
+                                                     const Device& device,
+                                                     const glm::ivec2& size,
+                                                     vk::Format format);
+
+}  // namespace Renderer
+}  // namespace Vortex2D
+
+#endif
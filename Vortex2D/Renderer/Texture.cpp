@@ -21,6 +21,7 @@ vk::DeviceSize GetBytesPerPixel(vk::Format format)
       return 1;
     case vk::Format::eR32Sfloat:
     case vk::Format::eR32Sint:
+    case vk::Format::eR16G16Sfloat:
     case vk::Format::eR8G8B8A8Unorm:
     case vk::Format::eB8G8R8A8Unorm:
       return 4;
@@ -9,6 +9,7 @@
 #include <Vortex2D/Renderer/Instance.h>
 #include <Vortex2D/Renderer/RenderTexture.h>
 #include <Vortex2D/Renderer/RenderWindow.h>
+#include <Vortex2D/Renderer/ResourcePool.h>
 #include <Vortex2D/Renderer/Shapes.h>
 
 #include <Vortex2D/Engine/Density.h>
@@ -23,7 +23,7 @@ set(vortex2d_macro__internal_dir ${CMAKE_CURRENT_LIST_DIR} CACHE INTERNAL "")
 
 # Function to compile the shaders and generate a C++ source file to include
 function(compile_shader)
-    cmake_parse_arguments(SHADER "" "OUTPUT;VERSION" "SOURCES" ${ARGN})
+    cmake_parse_arguments(SHADER "" "OUTPUT;VERSION;VARIANT_SUFFIX;VARIANT_DEFINE" "SOURCES;VARIANT_SOURCES" ${ARGN})
 
     if (NOT DEFINED GLSL_VALIDATOR)
       vortex2d_find_program(GLSL_VALIDATOR glslangValidator hints "$ENV{VULKAN_SDK}/Bin")
@@ -34,11 +34,17 @@ function(compile_shader)
 
     file(REMOVE "${SHADER_OUTPUT}.h" "${SHADER_OUTPUT}.cpp")
 
+    # Sources also compiled with a macro defined, named with a suffix
+    set(VARIANT_ARGS "")
+    if (SHADER_VARIANT_SOURCES)
+      set(VARIANT_ARGS --variant_suffix ${SHADER_VARIANT_SUFFIX} --variant_define ${SHADER_VARIANT_DEFINE} --variant_files ${SHADER_VARIANT_SOURCES})
+    endif()
+
     set(COMPILE_SCRIPT ${vortex2d_macro__internal_dir}/../Scripts/GenerateSPIRV.py)
     add_custom_command(
        OUTPUT "${SHADER_OUTPUT}.h" "${SHADER_OUTPUT}.cpp"
-       COMMAND ${PYTHON_EXECUTABLE} ${COMPILE_SCRIPT} --compiler ${GLSL_VALIDATOR} --vulkan_version ${SHADER_VERSION} --output ${SHADER_OUTPUT} ${SHADER_SOURCES}
-       DEPENDS ${SHADER_SOURCES} ${COMPILE_SCRIPT})
+       COMMAND ${PYTHON_EXECUTABLE} ${COMPILE_SCRIPT} --compiler ${GLSL_VALIDATOR} --vulkan_version ${SHADER_VERSION} --output ${SHADER_OUTPUT} ${SHADER_SOURCES} ${VARIANT_ARGS}
+       DEPENDS ${SHADER_SOURCES} ${SHADER_VARIANT_SOURCES} ${COMPILE_SCRIPT})
 endfunction()
 
 # Copy dlls